@@ -40,16 +40,19 @@ namespace CustomVulkanUtils {
         // class members
         VkInstance instance;
         VkDebugUtilsMessengerEXT debugMessenger;
+        const VkAllocationCallbacks* allocator; // same callbacks as the instance
 
 
         // functions
 
         CustomValidationLayer() {
             this->instance = nullptr;
+            this->allocator = nullptr;
         }
 
-        CustomValidationLayer(VkInstance instance) {
+        CustomValidationLayer(VkInstance instance, const VkAllocationCallbacks* allocator = nullptr) {
             this->instance = instance;
+            this->allocator = allocator;
         }
 
         void setupDebugMessenger() {
@@ -61,7 +64,7 @@ namespace CustomVulkanUtils {
             VkDebugUtilsMessengerCreateInfoEXT createInfo;
             populateDebugMessengerCreateInfo(createInfo);
 
-            if (CreateDebugUtilsMessengerEXT(instance, &createInfo, nullptr, &debugMessenger) != VK_SUCCESS) {
+            if (CreateDebugUtilsMessengerEXT(instance, &createInfo, allocator, &debugMessenger) != VK_SUCCESS) {
                 throw std::runtime_error("failed to set up debug messenger!");
             }
 
@@ -80,7 +83,7 @@ namespace CustomVulkanUtils {
             if (instance == nullptr)
                 return;
 
-            DestroyDebugUtilsMessengerEXT(instance, debugMessenger, nullptr);
+            DestroyDebugUtilsMessengerEXT(instance, debugMessenger, allocator);
         }
 
 
@@ -0,0 +1,310 @@
+#pragma once
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <cstdlib>
+#include <vector>
+#include <string>
+#include <memory>
+#include <mutex>
+#include <functional>
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+
+#include "PhysicalDeviceUtils.h"
+#include "GraphicsPipelineUtils.h"
+#include "MemoryResidencyManager.h"
+#include "JobSystem.h"
+
+namespace CustomVulkanUtils {
+
+	// everything one physical device needs to render on its own: logical device, queue, command pool, memory
+	struct DeviceContext {
+		VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
+		VkDevice device = VK_NULL_HANDLE;
+		uint32_t graphicsFamily = 0;
+		VkQueue graphicsQueue = VK_NULL_HANDLE;
+		VkCommandPool commandPool = VK_NULL_HANDLE;
+		std::string name;
+		const VkAllocationCallbacks* allocator = nullptr; // host allocation callbacks for everything created on this device
+
+		MemoryResidencyManager residencyManager;
+		std::mutex mutex; // queue and command pool need external synchronisation, one job per device at a time
+	};
+
+	// color image with its own command buffer and fence, stands in for a frame until there is a real draw path
+	struct OffscreenTarget {
+		VkImage image = VK_NULL_HANDLE;
+		VkDeviceMemory memory = VK_NULL_HANDLE;
+		ResidencyHandle memoryHandle = 0;
+		VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+		VkFence fence = VK_NULL_HANDLE; // signalled by the last submit of commandBuffer
+		bool submitted = false; // fence belongs to a submit nobody waited for yet
+		VkExtent2D extent{};
+	};
+
+	// create a logical device with a single graphics queue, for devices that never present
+	VkDevice createOffscreenLogicalDevice(VkPhysicalDevice physicalDevice, bool enableValidationLayers, std::vector<const char*> validationLayers, std::vector<const char*> deviceExtensions, uint32_t graphicsFamily, VkQueue& graphicsQueue, const VkAllocationCallbacks* allocator = nullptr) {
+
+		VkDevice device;
+
+		float queuePriority = 1.0f;
+		VkDeviceQueueCreateInfo queueCreateInfo{};
+		queueCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+		queueCreateInfo.queueFamilyIndex = graphicsFamily;
+		queueCreateInfo.queueCount = 1;
+		queueCreateInfo.pQueuePriorities = &queuePriority;
+
+		VkPhysicalDeviceFeatures deviceFeatures{};
+
+		VkDeviceCreateInfo createInfo{};
+		createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+		createInfo.queueCreateInfoCount = 1;
+		createInfo.pQueueCreateInfos = &queueCreateInfo;
+		createInfo.pEnabledFeatures = &deviceFeatures;
+		createInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
+		createInfo.ppEnabledExtensionNames = deviceExtensions.data();
+
+		if (enableValidationLayers) {
+			createInfo.enabledLayerCount = static_cast<uint32_t>(validationLayers.size());
+			createInfo.ppEnabledLayerNames = validationLayers.data();
+		}
+		else {
+			createInfo.enabledLayerCount = 0;
+		}
+
+		if (vkCreateDevice(physicalDevice, &createInfo, allocator, &device) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create offscreen logical device!");
+		}
+
+		vkGetDeviceQueue(device, graphicsFamily, 0, &graphicsQueue);
+
+		return device;
+	}
+
+
+	// One logical device per suitable physical device. Independent frames or jobs are spread over the devices,
+	// every device keeps its own queue, pipeline and memory.
+	class DeviceGroup {
+	public:
+
+		DeviceGroup() {}
+
+		~DeviceGroup() {
+			cleanup();
+		}
+
+		DeviceGroup(const DeviceGroup&) = delete;
+		DeviceGroup& operator=(const DeviceGroup&) = delete;
+
+		// maxDevices 0: use every suitable device. excludedDevice: a device that already has a logical device (the presenting
+		// one), so it does not get a second one. The group may end up empty then
+		void init(VkInstance instance, bool enableValidationLayers, std::vector<const char*> validationLayers, uint32_t maxDevices = 0, VkPhysicalDevice excludedDevice = VK_NULL_HANDLE, const VkAllocationCallbacks* allocator = nullptr) {
+			std::vector<const char*> deviceExtensions; // offscreen, no swap chain needed
+			std::vector<VkPhysicalDevice> physicalDevices = pickOffscreenPhysicalDevices(instance, deviceExtensions);
+
+			if (physicalDevices.empty()) {
+				throw std::runtime_error("failed to find a suitable GPU for the device group!");
+			}
+
+			physicalDevices.erase(std::remove(physicalDevices.begin(), physicalDevices.end(), excludedDevice), physicalDevices.end());
+
+			if (maxDevices > 0 && physicalDevices.size() > maxDevices) {
+				physicalDevices.resize(maxDevices);
+			}
+
+			auto vertShaderCode = readFile("shaders/vert.spv");
+			auto fragShaderCode = readFile("shaders/frag.spv");
+
+			for (VkPhysicalDevice physicalDevice : physicalDevices) {
+				auto context = std::make_unique<DeviceContext>();
+				context->physicalDevice = physicalDevice;
+				context->allocator = allocator;
+				context->graphicsFamily = findGraphicsQueueFamily(physicalDevice).value();
+
+				VkPhysicalDeviceProperties deviceProperties;
+				vkGetPhysicalDeviceProperties(physicalDevice, &deviceProperties);
+				context->name = deviceProperties.deviceName;
+
+				context->device = createOffscreenLogicalDevice(physicalDevice, enableValidationLayers, validationLayers, deviceExtensions, context->graphicsFamily, context->graphicsQueue, allocator);
+				context->residencyManager.init(physicalDevice, false, 0.9f, allocator);
+
+				VkCommandPoolCreateInfo poolInfo{};
+				poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+				poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+				poolInfo.queueFamilyIndex = context->graphicsFamily;
+
+				if (vkCreateCommandPool(context->device, &poolInfo, allocator, &context->commandPool) != VK_SUCCESS) {
+					throw std::runtime_error("failed to create command pool for device group!");
+				}
+
+				createGraphicsPipeline(context->device, vertShaderCode, fragShaderCode, allocator);
+
+				contexts.push_back(std::move(context));
+			}
+		}
+
+		void cleanup() {
+			for (auto& context : contexts) {
+				vkDeviceWaitIdle(context->device);
+				vkDestroyCommandPool(context->device, context->commandPool, context->allocator);
+				vkDestroyDevice(context->device, context->allocator);
+			}
+
+			contexts.clear();
+		}
+
+		uint32_t getDeviceCount() const {
+			return static_cast<uint32_t>(contexts.size());
+		}
+
+		DeviceContext& getDevice(uint32_t index) {
+			return *contexts[index];
+		}
+
+		// alternate frame rendering: frame i goes to device i % deviceCount, devices work in parallel on the job system
+		JobHandle submitFrame(JobSystem& jobSystem, uint64_t frameIndex, std::function<void(DeviceContext&)> frame) {
+			if (contexts.empty()) {
+				throw std::runtime_error("device group has no devices!");
+			}
+
+			DeviceContext* context = contexts[frameIndex % contexts.size()].get();
+
+			return jobSystem.schedule([context, frame]() {
+				std::lock_guard<std::mutex> lock(context->mutex);
+				frame(*context);
+			});
+		}
+
+		void printDevices() const {
+			std::cout << "device group:\n";
+			for (size_t i = 0; i < contexts.size(); i++) {
+				std::cout << '\t' << i << ": " << contexts[i]->name << '\n';
+			}
+		}
+
+	private:
+
+		std::vector<std::unique_ptr<DeviceContext>> contexts; // DeviceContext holds a mutex and must not move
+
+	};
+
+
+	OffscreenTarget createOffscreenTarget(DeviceContext& context, VkExtent2D extent) {
+		OffscreenTarget target;
+		target.extent = extent;
+
+		VkImageCreateInfo imageInfo{};
+		imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+		imageInfo.imageType = VK_IMAGE_TYPE_2D;
+		imageInfo.format = VK_FORMAT_R8G8B8A8_UNORM;
+		imageInfo.extent = { extent.width, extent.height, 1 };
+		imageInfo.mipLevels = 1;
+		imageInfo.arrayLayers = 1;
+		imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+		imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+		imageInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+		imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+		imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+		if (vkCreateImage(context.device, &imageInfo, context.allocator, &target.image) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create offscreen image!");
+		}
+
+		VkMemoryRequirements memRequirements;
+		vkGetImageMemoryRequirements(context.device, target.image, &memRequirements);
+		target.memoryHandle = context.residencyManager.allocateMemory(context.device, memRequirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, target.memory);
+		vkBindImageMemory(context.device, target.image, target.memory, 0);
+
+		VkCommandBufferAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		allocInfo.commandPool = context.commandPool;
+		allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+		allocInfo.commandBufferCount = 1;
+
+		if (vkAllocateCommandBuffers(context.device, &allocInfo, &target.commandBuffer) != VK_SUCCESS) {
+			throw std::runtime_error("failed to allocate offscreen command buffer!");
+		}
+
+		VkFenceCreateInfo fenceInfo{};
+		fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+
+		if (vkCreateFence(context.device, &fenceInfo, context.allocator, &target.fence) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create offscreen fence!");
+		}
+
+		return target;
+	}
+
+	// wait until the GPU is done with the last frame of the target. Caller holds context.mutex (or no job uses the target anymore)
+	void waitOffscreenTarget(DeviceContext& context, OffscreenTarget& target) {
+		if (!target.submitted) {
+			return;
+		}
+
+		vkWaitForFences(context.device, 1, &target.fence, VK_TRUE, UINT64_MAX);
+		vkResetFences(context.device, 1, &target.fence);
+		target.submitted = false;
+	}
+
+	void destroyOffscreenTarget(DeviceContext& context, OffscreenTarget& target) {
+		waitOffscreenTarget(context, target);
+		vkDestroyFence(context.device, target.fence, context.allocator);
+		vkFreeCommandBuffers(context.device, context.commandPool, 1, &target.commandBuffer);
+		vkDestroyImage(context.device, target.image, context.allocator);
+		context.residencyManager.freeMemory(context.device, target.memory, target.memoryHandle);
+		target = OffscreenTarget{};
+	}
+
+	// record and submit one frame that clears the target, without waiting for it. Only the previous frame of the same
+	// target is waited for, right before its command buffer is re-recorded. Caller holds context.mutex
+	void renderOffscreenFrame(DeviceContext& context, OffscreenTarget& target, VkClearColorValue clearColor) {
+		waitOffscreenTarget(context, target);
+
+		VkCommandBufferBeginInfo beginInfo{};
+		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+		if (vkBeginCommandBuffer(target.commandBuffer, &beginInfo) != VK_SUCCESS) {
+			throw std::runtime_error("failed to begin offscreen command buffer!");
+		}
+
+		VkImageSubresourceRange range{};
+		range.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		range.baseMipLevel = 0;
+		range.levelCount = 1;
+		range.baseArrayLayer = 0;
+		range.layerCount = 1;
+
+		// old content is not needed, every frame starts from UNDEFINED
+		VkImageMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		barrier.srcAccessMask = 0;
+		barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.image = target.image;
+		barrier.subresourceRange = range;
+
+		vkCmdPipelineBarrier(target.commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+		vkCmdClearColorImage(target.commandBuffer, target.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, &clearColor, 1, &range);
+
+		if (vkEndCommandBuffer(target.commandBuffer) != VK_SUCCESS) {
+			throw std::runtime_error("failed to record offscreen command buffer!");
+		}
+
+		VkSubmitInfo submitInfo{};
+		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		submitInfo.commandBufferCount = 1;
+		submitInfo.pCommandBuffers = &target.commandBuffer;
+
+		if (vkQueueSubmit(context.graphicsQueue, 1, &submitInfo, target.fence) != VK_SUCCESS) {
+			throw std::runtime_error("failed to submit offscreen frame!");
+		}
+		target.submitted = true;
+	}
+
+}
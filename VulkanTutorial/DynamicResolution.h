@@ -0,0 +1,443 @@
+#pragma once
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <cstdlib>
+#include <cstdint>
+#include <vector>
+#include <string>
+#include <cmath>
+#include <algorithm>
+#include <fstream>
+#include <stdexcept>
+
+#include "MemoryResidencyManager.h"
+
+namespace CustomVulkanUtils {
+
+	struct ResolutionScaleChange {
+		uint64_t frame;
+		float oldScale;
+		float newScale;
+		double gpuFrameMs; // smoothed GPU time that caused the change
+	};
+
+
+	// picks the render scale from measured GPU frame times: drops fast when over budget, grows slowly when below
+	class DynamicResolutionController {
+	public:
+
+		void init(double targetFrameMs, float minScale = 0.5f, float maxScale = 1.0f) {
+			if (targetFrameMs <= 0.0 || minScale <= 0.0f || minScale > maxScale) {
+				throw std::runtime_error("invalid dynamic resolution settings!");
+			}
+
+			this->targetFrameMs = targetFrameMs;
+			this->minScale = minScale;
+			this->maxScale = maxScale;
+			scale = maxScale;
+			smoothedMs = 0.0;
+			frame = 0;
+			framesSinceChange = 0;
+			changes.clear();
+		}
+
+		// feed the GPU time of a finished frame, returns the scale for the next one
+		float update(double gpuFrameMs) {
+			frame++;
+			framesSinceChange++;
+
+			// react to spikes quickly, but only recover slowly so the scale does not oscillate
+			double alpha = gpuFrameMs > smoothedMs ? 0.5 : 0.05;
+			smoothedMs = smoothedMs <= 0.0 ? gpuFrameMs : smoothedMs + alpha * (gpuFrameMs - smoothedMs);
+
+			if (framesSinceChange < cooldownFrames) {
+				return scale;
+			}
+
+			float newScale = scale;
+			double ratio = smoothedMs / targetFrameMs;
+
+			if (ratio > 1.0 + upperHeadroom) {
+				// GPU time scales with the pixel count, i.e. with scale^2
+				newScale = static_cast<float>(scale / std::sqrt(ratio));
+			}
+			else if (ratio < 1.0 - lowerHeadroom) {
+				newScale = scale + growStep;
+			}
+
+			newScale = std::clamp(newScale, minScale, maxScale);
+			newScale = std::round(newScale * 64.0f) / 64.0f; // coarse steps, tiny changes are not worth it
+
+			if (std::fabs(newScale - scale) >= 1.0f / 64.0f) {
+				changes.push_back({ frame, scale, newScale, smoothedMs });
+				scale = newScale;
+				framesSinceChange = 0;
+			}
+
+			return scale;
+		}
+
+		float getScale() const {
+			return scale;
+		}
+
+		// size of the region to render into, for a given full (swap chain) size
+		VkExtent2D scaledExtent(VkExtent2D fullExtent) const {
+			VkExtent2D extent;
+			extent.width = std::max(1u, static_cast<uint32_t>(fullExtent.width * scale + 0.5f));
+			extent.height = std::max(1u, static_cast<uint32_t>(fullExtent.height * scale + 0.5f));
+			return extent;
+		}
+
+		const std::vector<ResolutionScaleChange>& getChanges() const {
+			return changes;
+		}
+
+		void writeLog(const std::string& path) const {
+			std::ofstream file(path, std::ios::out | std::ios::trunc);
+			if (!file.is_open()) {
+				throw std::runtime_error("failed to open resolution scale log!");
+			}
+
+			file << "frame,old_scale,new_scale,gpu_frame_ms,target_ms\n";
+			for (const auto& change : changes) {
+				file << change.frame << ',' << change.oldScale << ',' << change.newScale << ',' << change.gpuFrameMs << ',' << targetFrameMs << '\n';
+			}
+		}
+
+	private:
+
+		const uint32_t cooldownFrames = 15; // frames between two changes, so the GPU time can settle
+		const double upperHeadroom = 0.05;
+		const double lowerHeadroom = 0.15;
+		const float growStep = 0.05f;
+
+		double targetFrameMs = 16.6;
+		float minScale = 0.5f;
+		float maxScale = 1.0f;
+		float scale = 1.0f;
+		double smoothedMs = 0.0;
+		uint64_t frame = 0;
+		uint32_t framesSinceChange = 0;
+		std::vector<ResolutionScaleChange> changes;
+
+	};
+
+
+	// GPU time of the commands between begin and end, two timestamp queries per frame in flight
+	class GpuFrameTimer {
+	public:
+
+		// returns false if the queue family does not support timestamps
+		bool init(VkPhysicalDevice physicalDevice, VkDevice device, uint32_t queueFamily, uint32_t framesInFlight, const VkAllocationCallbacks* allocator = nullptr) {
+			this->device = device;
+			this->allocator = allocator;
+
+			VkPhysicalDeviceProperties deviceProperties;
+			vkGetPhysicalDeviceProperties(physicalDevice, &deviceProperties);
+			timestampPeriodNs = deviceProperties.limits.timestampPeriod;
+
+			uint32_t queueFamilyCount = 0;
+			vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, nullptr);
+			std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+			vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, queueFamilies.data());
+
+			if (queueFamilies[queueFamily].timestampValidBits == 0 || timestampPeriodNs <= 0.0f) {
+				return false;
+			}
+
+			VkQueryPoolCreateInfo createInfo{};
+			createInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+			createInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+			createInfo.queryCount = 2 * framesInFlight;
+
+			if (vkCreateQueryPool(device, &createInfo, allocator, &queryPool) != VK_SUCCESS) {
+				throw std::runtime_error("failed to create timestamp query pool!");
+			}
+
+			written.assign(framesInFlight, false);
+			return true;
+		}
+
+		void cleanup() {
+			if (queryPool != VK_NULL_HANDLE) {
+				vkDestroyQueryPool(device, queryPool, allocator);
+				queryPool = VK_NULL_HANDLE;
+			}
+		}
+
+		void begin(VkCommandBuffer commandBuffer, uint32_t frameSlot) {
+			vkCmdResetQueryPool(commandBuffer, queryPool, 2 * frameSlot, 2);
+			vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, queryPool, 2 * frameSlot);
+		}
+
+		void end(VkCommandBuffer commandBuffer, uint32_t frameSlot) {
+			vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, queryPool, 2 * frameSlot + 1);
+			written[frameSlot] = true;
+		}
+
+		// GPU time of the last frame in this slot. Call after the fence of that frame was waited on
+		bool read(uint32_t frameSlot, double& gpuFrameMs) {
+			if (!written[frameSlot]) {
+				return false;
+			}
+
+			uint64_t timestamps[2];
+			if (vkGetQueryPoolResults(device, queryPool, 2 * frameSlot, 2, sizeof(timestamps), timestamps, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT) != VK_SUCCESS) {
+				return false;
+			}
+
+			gpuFrameMs = static_cast<double>(timestamps[1] - timestamps[0]) * timestampPeriodNs / 1.0e6;
+			return true;
+		}
+
+	private:
+
+		VkDevice device = VK_NULL_HANDLE;
+		const VkAllocationCallbacks* allocator = nullptr;
+		VkQueryPool queryPool = VK_NULL_HANDLE;
+		float timestampPeriodNs = 0.0f;
+		std::vector<bool> written;
+
+	};
+
+
+	// Offscreen color target allocated once at the maximum size. Lower scales only render into its top left
+	// sub-rectangle, so a scale change never reallocates. The result is upscaled into the swap chain image with a blit.
+	class ScaledRenderTarget {
+	public:
+
+		// the upscale blits from a target of the swap chain format into a swap chain image: the format needs blit support
+		// and the swap chain images the transfer destination usage (swapChainUsage: supportedUsageFlags of the surface)
+		static bool isSupported(VkPhysicalDevice physicalDevice, VkFormat format, VkImageUsageFlags swapChainUsage) {
+			VkFormatProperties formatProperties;
+			vkGetPhysicalDeviceFormatProperties(physicalDevice, format, &formatProperties);
+
+			VkFlags requiredFeatures = VK_FORMAT_FEATURE_COLOR_ATTACHMENT_BIT | VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT;
+			return (formatProperties.optimalTilingFeatures & requiredFeatures) == requiredFeatures && (swapChainUsage & VK_IMAGE_USAGE_TRANSFER_DST_BIT);
+		}
+
+		void init(VkPhysicalDevice physicalDevice, VkDevice device, MemoryResidencyManager& residencyManager, VkExtent2D maxExtent, VkFormat format, const VkAllocationCallbacks* allocator = nullptr) {
+			this->device = device;
+			this->residencyManager = &residencyManager;
+			this->allocator = allocator;
+			this->maxExtent = maxExtent;
+			this->format = format;
+
+			// linear filtering for the upscale if the format allows it
+			VkFormatProperties formatProperties;
+			vkGetPhysicalDeviceFormatProperties(physicalDevice, format, &formatProperties);
+			filter = (formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT) ? VK_FILTER_LINEAR : VK_FILTER_NEAREST;
+
+			VkImageCreateInfo imageInfo{};
+			imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+			imageInfo.imageType = VK_IMAGE_TYPE_2D;
+			imageInfo.format = format;
+			imageInfo.extent = { maxExtent.width, maxExtent.height, 1 };
+			imageInfo.mipLevels = 1;
+			imageInfo.arrayLayers = 1;
+			imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+			imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+			imageInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+			imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+			imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+			if (vkCreateImage(device, &imageInfo, allocator, &image) != VK_SUCCESS) {
+				throw std::runtime_error("failed to create scaled render target!");
+			}
+
+			VkMemoryRequirements memRequirements;
+			vkGetImageMemoryRequirements(device, image, &memRequirements);
+			memoryHandle = residencyManager.allocateMemory(device, memRequirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, memory);
+			vkBindImageMemory(device, image, memory, 0);
+
+			VkImageViewCreateInfo viewInfo{};
+			viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+			viewInfo.image = image;
+			viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+			viewInfo.format = format;
+			viewInfo.subresourceRange = colorRange();
+
+			if (vkCreateImageView(device, &viewInfo, allocator, &imageView) != VK_SUCCESS) {
+				throw std::runtime_error("failed to create scaled render target view!");
+			}
+
+			createScenePass();
+		}
+
+		void cleanup() {
+			if (image == VK_NULL_HANDLE) {
+				return;
+			}
+
+			vkDestroyFramebuffer(device, framebuffer, allocator);
+			vkDestroyRenderPass(device, renderPass, allocator);
+			vkDestroyImageView(device, imageView, allocator);
+			vkDestroyImage(device, image, allocator);
+			residencyManager->freeMemory(device, memory, memoryHandle);
+			image = VK_NULL_HANDLE;
+		}
+
+		// region the scene has to render into (viewport and scissor)
+		VkRect2D renderArea(VkExtent2D scaledExtent) const {
+			VkRect2D area{};
+			area.offset = { 0, 0 };
+			area.extent.width = std::min(scaledExtent.width, maxExtent.width);
+			area.extent.height = std::min(scaledExtent.height, maxExtent.height);
+			return area;
+		}
+
+		// begin the scene pass on renderArea(scaledExtent): the load op only clears that rectangle, so the GPU cost of the
+		// pass follows the scale. Scene draws are recorded between beginScenePass and endScenePass
+		void beginScenePass(VkCommandBuffer commandBuffer, VkExtent2D scaledExtent, VkClearColorValue clearColor) {
+			VkClearValue clearValue{};
+			clearValue.color = clearColor;
+
+			VkRenderPassBeginInfo beginInfo{};
+			beginInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+			beginInfo.renderPass = renderPass;
+			beginInfo.framebuffer = framebuffer;
+			beginInfo.renderArea = renderArea(scaledExtent);
+			beginInfo.clearValueCount = 1;
+			beginInfo.pClearValues = &clearValue;
+
+			vkCmdBeginRenderPass(commandBuffer, &beginInfo, VK_SUBPASS_CONTENTS_INLINE);
+		}
+
+		// leaves the target in TRANSFER_SRC_OPTIMAL for recordUpscale
+		void endScenePass(VkCommandBuffer commandBuffer) {
+			vkCmdEndRenderPass(commandBuffer);
+		}
+
+		// blit the rendered sub-rectangle onto the whole swap chain image and leave that ready for presenting
+		void recordUpscale(VkCommandBuffer commandBuffer, VkExtent2D scaledExtent, VkImage swapChainImage, VkExtent2D swapChainExtent) {
+			VkRect2D area = renderArea(scaledExtent);
+
+			transition(commandBuffer, swapChainImage, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+				0, VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+			VkImageBlit blit{};
+			blit.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+			blit.srcOffsets[0] = { 0, 0, 0 };
+			blit.srcOffsets[1] = { static_cast<int32_t>(area.extent.width), static_cast<int32_t>(area.extent.height), 1 };
+			blit.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+			blit.dstOffsets[0] = { 0, 0, 0 };
+			blit.dstOffsets[1] = { static_cast<int32_t>(swapChainExtent.width), static_cast<int32_t>(swapChainExtent.height), 1 };
+
+			vkCmdBlitImage(commandBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, swapChainImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blit, filter);
+
+			transition(commandBuffer, swapChainImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+				VK_ACCESS_TRANSFER_WRITE_BIT, 0, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT);
+		}
+
+	private:
+
+		VkDevice device = VK_NULL_HANDLE;
+		MemoryResidencyManager* residencyManager = nullptr;
+		const VkAllocationCallbacks* allocator = nullptr;
+
+		VkImage image = VK_NULL_HANDLE;
+		VkDeviceMemory memory = VK_NULL_HANDLE;
+		ResidencyHandle memoryHandle = 0;
+		VkImageView imageView = VK_NULL_HANDLE;
+		VkRenderPass renderPass = VK_NULL_HANDLE;
+		VkFramebuffer framebuffer = VK_NULL_HANDLE;
+		VkExtent2D maxExtent{};
+		VkFormat format = VK_FORMAT_UNDEFINED;
+		VkFilter filter = VK_FILTER_LINEAR;
+
+		// one color attachment over the whole target, the render area of each frame picks the sub-rectangle
+		void createScenePass() {
+			VkAttachmentDescription colorAttachment{};
+			colorAttachment.format = format;
+			colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+			colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+			colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+			colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+			colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+			colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED; // last frame is not needed, outside the render area stays undefined
+			colorAttachment.finalLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+
+			VkAttachmentReference colorReference{};
+			colorReference.attachment = 0;
+			colorReference.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+			VkSubpassDescription subpass{};
+			subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+			subpass.colorAttachmentCount = 1;
+			subpass.pColorAttachments = &colorReference;
+
+			VkSubpassDependency dependencies[2]{};
+			// the blit of the previous frame has to finish reading before the clear overwrites the target
+			dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+			dependencies[0].dstSubpass = 0;
+			dependencies[0].srcStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
+			dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+			dependencies[0].srcAccessMask = 0;
+			dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+			// and the blit of this frame waits for the scene
+			dependencies[1].srcSubpass = 0;
+			dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+			dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+			dependencies[1].dstStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
+			dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+			dependencies[1].dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+
+			VkRenderPassCreateInfo renderPassInfo{};
+			renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+			renderPassInfo.attachmentCount = 1;
+			renderPassInfo.pAttachments = &colorAttachment;
+			renderPassInfo.subpassCount = 1;
+			renderPassInfo.pSubpasses = &subpass;
+			renderPassInfo.dependencyCount = 2;
+			renderPassInfo.pDependencies = dependencies;
+
+			if (vkCreateRenderPass(device, &renderPassInfo, allocator, &renderPass) != VK_SUCCESS) {
+				throw std::runtime_error("failed to create scene render pass!");
+			}
+
+			VkFramebufferCreateInfo framebufferInfo{};
+			framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+			framebufferInfo.renderPass = renderPass;
+			framebufferInfo.attachmentCount = 1;
+			framebufferInfo.pAttachments = &imageView;
+			framebufferInfo.width = maxExtent.width;
+			framebufferInfo.height = maxExtent.height;
+			framebufferInfo.layers = 1;
+
+			if (vkCreateFramebuffer(device, &framebufferInfo, allocator, &framebuffer) != VK_SUCCESS) {
+				throw std::runtime_error("failed to create scene framebuffer!");
+			}
+		}
+
+		static VkImageSubresourceRange colorRange() {
+			VkImageSubresourceRange range{};
+			range.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			range.baseMipLevel = 0;
+			range.levelCount = 1;
+			range.baseArrayLayer = 0;
+			range.layerCount = 1;
+			return range;
+		}
+
+		static void transition(VkCommandBuffer commandBuffer, VkImage image, VkImageLayout oldLayout, VkImageLayout newLayout,
+			VkAccessFlags srcAccess, VkAccessFlags dstAccess, VkPipelineStageFlags srcStage, VkPipelineStageFlags dstStage) {
+
+			VkImageMemoryBarrier barrier{};
+			barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+			barrier.srcAccessMask = srcAccess;
+			barrier.dstAccessMask = dstAccess;
+			barrier.oldLayout = oldLayout;
+			barrier.newLayout = newLayout;
+			barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			barrier.image = image;
+			barrier.subresourceRange = colorRange();
+
+			vkCmdPipelineBarrier(commandBuffer, srcStage, dstStage, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+		}
+
+	};
+
+}
@@ -0,0 +1,155 @@
+#pragma once
+
+#include <cstdlib>
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include <memory>
+#include <new>
+
+namespace CustomVulkanUtils {
+
+	// Linear allocator for transient CPU data of one frame: allocation is a pointer bump, reset() frees everything at once.
+	// Not thread safe, use one arena per thread. Memory must not be used after reset().
+	class FrameArena {
+	public:
+
+		explicit FrameArena(size_t capacity = 1024 * 1024) : buffer(new std::byte[capacity]), capacity(capacity) {}
+
+		~FrameArena() {
+			releaseOverflow();
+		}
+
+		FrameArena(const FrameArena&) = delete;
+		FrameArena& operator=(const FrameArena&) = delete;
+
+		void* allocate(size_t size, size_t alignment) {
+			size_t aligned = (offset + alignment - 1) / alignment * alignment;
+
+			if (aligned + size > capacity) {
+				// arena too small for this frame: still works, but shows up in the stats so the capacity can be raised
+				void* memory = heapAllocate(size, alignment);
+				overflow.push_back({ memory, alignment });
+				overflowBytes += size;
+				return memory;
+			}
+
+			offset = aligned + size;
+			allocations++;
+			return buffer.get() + aligned;
+		}
+
+		// call at the end of every frame
+		void reset() {
+			if (offset > peakBytes) {
+				peakBytes = offset;
+			}
+
+			lastFrameBytes = offset;
+			lastFrameAllocations = allocations;
+			lastFrameOverflowBytes = overflowBytes;
+
+			offset = 0;
+			allocations = 0;
+			overflowBytes = 0;
+			releaseOverflow();
+		}
+
+		// heap fallback for overflow and arena-less containers. Aligned operator new only for over-aligned requests,
+		// so a replaced plain operator new (the allocation count of the benchmark) still sees ordinary allocations
+		static void* heapAllocate(size_t size, size_t alignment) {
+			if (alignment > __STDCPP_DEFAULT_NEW_ALIGNMENT__) {
+				return ::operator new(size, std::align_val_t(alignment));
+			}
+			return ::operator new(size);
+		}
+
+		static void heapFree(void* memory, size_t alignment) {
+			if (alignment > __STDCPP_DEFAULT_NEW_ALIGNMENT__) {
+				::operator delete(memory, std::align_val_t(alignment));
+			}
+			else {
+				::operator delete(memory);
+			}
+		}
+
+		size_t getCapacity() const { return capacity; }
+		size_t getPeakBytes() const { return peakBytes; }
+		size_t getLastFrameBytes() const { return lastFrameBytes; }
+		size_t getLastFrameAllocations() const { return lastFrameAllocations; }
+		size_t getLastFrameOverflowBytes() const { return lastFrameOverflowBytes; }
+
+	private:
+
+		std::unique_ptr<std::byte[]> buffer;
+		size_t capacity;
+		size_t offset = 0;
+		size_t allocations = 0;
+
+		struct OverflowAllocation {
+			void* memory;
+			size_t alignment; // the aligned operator delete needs the alignment of the operator new call
+		};
+
+		std::vector<OverflowAllocation> overflow;
+		size_t overflowBytes = 0;
+
+		size_t peakBytes = 0;
+		size_t lastFrameBytes = 0;
+		size_t lastFrameAllocations = 0;
+		size_t lastFrameOverflowBytes = 0;
+
+		void releaseOverflow() {
+			for (const auto& allocation : overflow) {
+				heapFree(allocation.memory, allocation.alignment);
+			}
+			overflow.clear();
+		}
+
+	};
+
+
+	// STL allocator on top of a FrameArena, deallocate is a no-op. Without an arena it falls back to the heap,
+	// so code can use arena containers whether or not a frame arena is set up
+	template <typename T>
+	class ArenaAllocator {
+	public:
+
+		typedef T value_type;
+
+		ArenaAllocator(FrameArena* arena = nullptr) : arena(arena) {}
+
+		template <typename U>
+		ArenaAllocator(const ArenaAllocator<U>& other) : arena(other.arena) {}
+
+		T* allocate(size_t count) {
+			if (arena == nullptr) {
+				return static_cast<T*>(FrameArena::heapAllocate(count * sizeof(T), alignof(T)));
+			}
+			return static_cast<T*>(arena->allocate(count * sizeof(T), alignof(T)));
+		}
+
+		void deallocate(T* memory, size_t /*count*/) {
+			if (arena == nullptr) {
+				FrameArena::heapFree(memory, alignof(T));
+			}
+		}
+
+		template <typename U>
+		bool operator==(const ArenaAllocator<U>& other) const {
+			return arena == other.arena;
+		}
+
+		template <typename U>
+		bool operator!=(const ArenaAllocator<U>& other) const {
+			return arena != other.arena;
+		}
+
+		FrameArena* arena;
+
+	};
+
+	template <typename T>
+	using ArenaVector = std::vector<T, ArenaAllocator<T>>;
+
+}
@@ -0,0 +1,401 @@
+#pragma once
+
+#include <cstdlib>
+#include <cstdint>
+#include <vector>
+#include <array>
+#include <string>
+#include <atomic>
+#include <mutex>
+#include <memory>
+#include <unordered_map>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+
+namespace CustomVulkanUtils {
+
+	// stages of one iteration of the frame loop that get their own histogram
+	enum class FrameStage : uint32_t {
+		Acquire,
+		Record,
+		Submit,
+		Present,
+		FenceWait,
+		Frame, // whole loop iteration
+		Count
+	};
+
+	static const char* frameStageName(FrameStage stage) {
+		static const char* names[] = { "acquire", "record", "submit", "present", "fence_wait", "frame" };
+		return names[static_cast<uint32_t>(stage)];
+	}
+
+	enum class ProfilerExportFormat {
+		None,
+		CSV,
+		JSON // one JSON object per line
+	};
+
+	struct FrameProfilerConfig {
+		uint32_t windowFrames = 300; // frames per statistics window
+		double exportIntervalSeconds = 5.0;
+		ProfilerExportFormat exportFormat = ProfilerExportFormat::None;
+		std::string exportPath = "frame_timings.csv";
+	};
+
+	struct FrameStageStats {
+		uint64_t count = 0;
+		uint64_t p50Ns = 0;
+		uint64_t p95Ns = 0;
+		uint64_t p99Ns = 0;
+		uint64_t maxNs = 0;
+	};
+
+
+	// Histogram with fixed buckets: exact below 16ns, then 8 buckets per power of two (max. 12.5% relative error)
+	class FrameTimeHistogram {
+	public:
+
+		static const uint32_t linearBuckets = 16;
+		static const uint32_t subBucketBits = 3;
+		static const uint32_t bucketCount = linearBuckets + (64 - 4) * (1 << subBucketBits);
+
+		void record(uint64_t valueNs) {
+			counts[bucketIndex(valueNs)]++;
+			total++;
+			if (valueNs > maxValue) {
+				maxValue = valueNs;
+			}
+		}
+
+		void reset() {
+			counts.fill(0);
+			total = 0;
+			maxValue = 0;
+		}
+
+		// upper bound of the bucket that contains the given percentile (0..1), never larger than the maximum
+		uint64_t percentile(double p) const {
+			if (total == 0) {
+				return 0;
+			}
+
+			uint64_t target = static_cast<uint64_t>(p * total + 0.5);
+			if (target == 0) {
+				target = 1;
+			}
+
+			uint64_t accumulated = 0;
+			for (uint32_t i = 0; i < bucketCount; i++) {
+				accumulated += counts[i];
+				if (accumulated >= target) {
+					uint64_t upper = bucketUpperBound(i);
+					return upper < maxValue ? upper : maxValue;
+				}
+			}
+
+			return maxValue;
+		}
+
+		uint64_t getCount() const {
+			return total;
+		}
+
+		uint64_t getMax() const {
+			return maxValue;
+		}
+
+	private:
+
+		std::array<uint32_t, bucketCount> counts{};
+		uint64_t total = 0;
+		uint64_t maxValue = 0;
+
+		static uint32_t highestBit(uint64_t value) {
+			uint32_t bit = 0;
+			while (value >>= 1) {
+				bit++;
+			}
+			return bit;
+		}
+
+		static uint32_t bucketIndex(uint64_t value) {
+			if (value < linearBuckets) {
+				return static_cast<uint32_t>(value);
+			}
+
+			uint32_t msb = highestBit(value);
+			uint32_t sub = static_cast<uint32_t>(value >> (msb - subBucketBits)) & ((1 << subBucketBits) - 1);
+			return linearBuckets + (msb - 4) * (1 << subBucketBits) + sub;
+		}
+
+		static uint64_t bucketUpperBound(uint32_t index) {
+			if (index < linearBuckets) {
+				return index;
+			}
+
+			uint32_t msb = (index - linearBuckets) / (1 << subBucketBits) + 4;
+			uint64_t sub = (index - linearBuckets) % (1 << subBucketBits);
+			uint64_t width = 1ull << (msb - subBucketBits);
+			return (1ull << msb) + (sub + 1) * width - 1;
+		}
+
+	};
+
+
+	// single producer (the owning thread) / single consumer (the frame loop) ring buffer, no locks on the recording side
+	class ThreadSampleBuffer {
+	public:
+
+		struct Sample {
+			FrameStage stage;
+			uint64_t durationNs;
+		};
+
+		static const uint32_t capacity = 1024; // power of two
+
+		void push(FrameStage stage, uint64_t durationNs) {
+			uint32_t head = writeIndex.load(std::memory_order_relaxed);
+			if (head - readIndex.load(std::memory_order_acquire) >= capacity) {
+				dropped.fetch_add(1, std::memory_order_relaxed); // consumer is behind, never block the recording thread
+				return;
+			}
+
+			samples[head & (capacity - 1)] = { stage, durationNs };
+			writeIndex.store(head + 1, std::memory_order_release);
+		}
+
+		template <typename Func>
+		void drain(Func&& func) {
+			uint32_t tail = readIndex.load(std::memory_order_relaxed);
+			uint32_t head = writeIndex.load(std::memory_order_acquire);
+
+			for (; tail != head; tail++) {
+				func(samples[tail & (capacity - 1)]);
+			}
+
+			readIndex.store(tail, std::memory_order_release);
+		}
+
+		uint64_t droppedSamples() const {
+			return dropped.load(std::memory_order_relaxed);
+		}
+
+	private:
+
+		std::array<Sample, capacity> samples{};
+		std::atomic<uint32_t> writeIndex{ 0 };
+		std::atomic<uint32_t> readIndex{ 0 };
+		std::atomic<uint64_t> dropped{ 0 };
+
+	};
+
+
+	class FrameProfiler {
+	public:
+
+		FrameProfiler() : id(nextProfilerId.fetch_add(1, std::memory_order_relaxed)) {
+			lastExport = std::chrono::steady_clock::now();
+		}
+
+		void init(const FrameProfilerConfig& config) {
+			if (config.windowFrames == 0) {
+				throw std::runtime_error("frame profiler window needs at least one frame!");
+			}
+
+			this->config = config;
+			framesInWindow = 0;
+			lastExport = std::chrono::steady_clock::now();
+
+			if (config.exportFormat != ProfilerExportFormat::None) {
+				exportFile.open(config.exportPath, std::ios::out | std::ios::trunc);
+				if (!exportFile.is_open()) {
+					throw std::runtime_error("failed to open frame timing export file!");
+				}
+
+				if (config.exportFormat == ProfilerExportFormat::CSV) {
+					exportFile << "frame,stage,count,p50_us,p95_us,p99_us,max_us\n";
+				}
+			}
+		}
+
+		// record one duration for the calling thread, safe to call from any thread
+		void record(FrameStage stage, uint64_t durationNs) {
+			threadBuffer().push(stage, durationNs);
+		}
+
+		// call once at the end of every frame on the frame loop thread: collect samples, close windows, export
+		void endFrame() {
+			{
+				std::lock_guard<std::mutex> lock(buffersMutex); // only contended when a new thread registers
+				for (auto& buffer : buffers) {
+					buffer->drain([this](const ThreadSampleBuffer::Sample& sample) {
+						histograms[static_cast<uint32_t>(sample.stage)].record(sample.durationNs);
+					});
+				}
+			}
+
+			frameIndex++;
+			if (++framesInWindow >= config.windowFrames) {
+				closeWindow();
+
+				// export the first window that closes after the interval, every window at most once
+				if (config.exportFormat != ProfilerExportFormat::None) {
+					auto now = std::chrono::steady_clock::now();
+					if (std::chrono::duration<double>(now - lastExport).count() >= config.exportIntervalSeconds) {
+						exportStats();
+						lastExport = now;
+					}
+				}
+			}
+		}
+
+		// statistics of the last completed window
+		const FrameStageStats& getStats(FrameStage stage) const {
+			return windowStats[static_cast<uint32_t>(stage)];
+		}
+
+		void printStats() const {
+			std::cout << "frame timings (last " << config.windowFrames << " frames, us):\n";
+			for (uint32_t i = 0; i < stageCount; i++) {
+				const FrameStageStats& stats = windowStats[i];
+				if (stats.count == 0) {
+					continue;
+				}
+
+				std::cout << '\t' << frameStageName(static_cast<FrameStage>(i))
+					<< ": p50 " << toMicroseconds(stats.p50Ns)
+					<< ", p95 " << toMicroseconds(stats.p95Ns)
+					<< ", p99 " << toMicroseconds(stats.p99Ns)
+					<< ", max " << toMicroseconds(stats.maxNs) << '\n';
+			}
+		}
+
+		// samples lost because a thread recorded more than a buffer holds between two endFrame calls
+		uint64_t droppedSamples() {
+			std::lock_guard<std::mutex> lock(buffersMutex);
+
+			uint64_t dropped = 0;
+			for (auto& buffer : buffers) {
+				dropped += buffer->droppedSamples();
+			}
+			return dropped;
+		}
+
+	private:
+
+		static const uint32_t stageCount = static_cast<uint32_t>(FrameStage::Count);
+
+		// ids are never reused, so a thread_local cache entry can not point to the buffer of a destroyed profiler
+		static inline std::atomic<uint64_t> nextProfilerId{ 1 };
+		const uint64_t id;
+
+		FrameProfilerConfig config;
+		std::array<FrameTimeHistogram, stageCount> histograms;
+		std::array<FrameStageStats, stageCount> windowStats;
+		uint64_t frameIndex = 0;
+		uint64_t windowEndFrame = 0; // last frame of the window in windowStats
+		uint32_t framesInWindow = 0;
+
+		std::mutex buffersMutex;
+		std::vector<std::unique_ptr<ThreadSampleBuffer>> buffers;
+
+		std::ofstream exportFile;
+		std::chrono::steady_clock::time_point lastExport;
+
+		// every thread registers its own buffer on first use, afterwards recording never locks
+		ThreadSampleBuffer& threadBuffer() {
+			thread_local uint64_t lastOwner = 0;
+			thread_local ThreadSampleBuffer* lastBuffer = nullptr;
+			thread_local std::unordered_map<uint64_t, ThreadSampleBuffer*> ownedBuffers; // for threads that use several profilers
+
+			if (lastOwner != id) {
+				ThreadSampleBuffer*& buffer = ownedBuffers[id];
+				if (buffer == nullptr) {
+					std::lock_guard<std::mutex> lock(buffersMutex);
+					buffers.push_back(std::make_unique<ThreadSampleBuffer>());
+					buffer = buffers.back().get();
+				}
+
+				lastOwner = id;
+				lastBuffer = buffer;
+			}
+
+			return *lastBuffer;
+		}
+
+		void closeWindow() {
+			for (uint32_t i = 0; i < stageCount; i++) {
+				FrameStageStats& stats = windowStats[i];
+				stats.count = histograms[i].getCount();
+				stats.p50Ns = histograms[i].percentile(0.50);
+				stats.p95Ns = histograms[i].percentile(0.95);
+				stats.p99Ns = histograms[i].percentile(0.99);
+				stats.maxNs = histograms[i].getMax();
+				histograms[i].reset();
+			}
+
+			framesInWindow = 0;
+			windowEndFrame = frameIndex;
+		}
+
+		void exportStats() {
+			if (config.exportFormat == ProfilerExportFormat::CSV) {
+				for (uint32_t i = 0; i < stageCount; i++) {
+					const FrameStageStats& stats = windowStats[i];
+					exportFile << windowEndFrame << ',' << frameStageName(static_cast<FrameStage>(i)) << ',' << stats.count << ','
+						<< toMicroseconds(stats.p50Ns) << ',' << toMicroseconds(stats.p95Ns) << ','
+						<< toMicroseconds(stats.p99Ns) << ',' << toMicroseconds(stats.maxNs) << '\n';
+				}
+			}
+			else if (config.exportFormat == ProfilerExportFormat::JSON) {
+				exportFile << "{\"frame\":" << windowEndFrame << ",\"stages\":{";
+				for (uint32_t i = 0; i < stageCount; i++) {
+					const FrameStageStats& stats = windowStats[i];
+					exportFile << (i > 0 ? "," : "") << '"' << frameStageName(static_cast<FrameStage>(i)) << "\":{"
+						<< "\"count\":" << stats.count
+						<< ",\"p50_us\":" << toMicroseconds(stats.p50Ns)
+						<< ",\"p95_us\":" << toMicroseconds(stats.p95Ns)
+						<< ",\"p99_us\":" << toMicroseconds(stats.p99Ns)
+						<< ",\"max_us\":" << toMicroseconds(stats.maxNs) << '}';
+				}
+				exportFile << "}}\n";
+			}
+
+			exportFile.flush();
+		}
+
+		static double toMicroseconds(uint64_t ns) {
+			return static_cast<double>(ns) / 1000.0;
+		}
+
+	};
+
+
+	// measures the lifetime of the scope: two clock reads and a lock free push, well below a microsecond
+	class ScopedFrameTimer {
+	public:
+
+		ScopedFrameTimer(FrameProfiler& profiler, FrameStage stage) : profiler(profiler), stage(stage) {
+			start = std::chrono::steady_clock::now();
+		}
+
+		~ScopedFrameTimer() {
+			auto end = std::chrono::steady_clock::now();
+			profiler.record(stage, static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count()));
+		}
+
+		ScopedFrameTimer(const ScopedFrameTimer&) = delete;
+		ScopedFrameTimer& operator=(const ScopedFrameTimer&) = delete;
+
+	private:
+
+		FrameProfiler& profiler;
+		FrameStage stage;
+		std::chrono::steady_clock::time_point start;
+
+	};
+
+}
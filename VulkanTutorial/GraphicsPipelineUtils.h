@@ -10,13 +10,11 @@
 namespace CustomVulkanUtils {
 
 
-	void createGraphicsPipeline(VkDevice& device) {
+	// shader code is passed in, so loading the files can happen in parallel to device creation
+	void createGraphicsPipeline(VkDevice& device, const std::vector<char>& vertShaderCode, const std::vector<char>& fragShaderCode, const VkAllocationCallbacks* allocator = nullptr) {
 
-		auto vertShaderCode = readFile("shaders/vert.spv");
-		auto fragShaderCode = readFile("shaders/frag.spv");
-
-		VkShaderModule vertShaderModule = createShaderModule(vertShaderCode, device);
-		VkShaderModule fragShaderModule = createShaderModule(fragShaderCode, device);
+		VkShaderModule vertShaderModule = createShaderModule(vertShaderCode, device, allocator);
+		VkShaderModule fragShaderModule = createShaderModule(fragShaderCode, device, allocator);
 
 		VkPipelineShaderStageCreateInfo vertShaderStageInfo{};
 		vertShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
@@ -33,8 +31,15 @@ namespace CustomVulkanUtils {
 		VkPipelineShaderStageCreateInfo shaderStages[] = { vertShaderStageInfo, fragShaderStageInfo };
 
 		// can delete wrappers for shadercode, as the shader code is already linked into the pipeline
-		vkDestroyShaderModule(device, fragShaderModule, nullptr);
-		vkDestroyShaderModule(device, vertShaderModule, nullptr);
+		vkDestroyShaderModule(device, fragShaderModule, allocator);
+		vkDestroyShaderModule(device, vertShaderModule, allocator);
+	}
+
+	void createGraphicsPipeline(VkDevice& device, const VkAllocationCallbacks* allocator = nullptr) {
+		auto vertShaderCode = readFile("shaders/vert.spv");
+		auto fragShaderCode = readFile("shaders/frag.spv");
+
+		createGraphicsPipeline(device, vertShaderCode, fragShaderCode, allocator);
 	}
 
 }
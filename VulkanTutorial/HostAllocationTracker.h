@@ -0,0 +1,193 @@
+#pragma once
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <cstdlib>
+#include <cstdint>
+#include <cstring>
+#include <array>
+#include <atomic>
+#include <algorithm>
+#include <iostream>
+
+namespace CustomVulkanUtils {
+
+	struct HostAllocationStats {
+		uint64_t allocations = 0; // includes reallocations
+		uint64_t frees = 0;
+		uint64_t internalAllocations = 0; // driver allocations it only reports (pfnInternalAllocation)
+		uint64_t allocatedBytes = 0; // total over the lifetime
+		uint64_t currentBytes = 0;
+		uint64_t peakBytes = 0;
+	};
+
+	// VkAllocationCallbacks that count every host allocation of the driver, grouped by VkSystemAllocationScope
+	class HostAllocationTracker {
+	public:
+
+		static const uint32_t scopeCount = VK_SYSTEM_ALLOCATION_SCOPE_INSTANCE + 1;
+
+		HostAllocationTracker() {
+			callbacks.pUserData = this;
+			callbacks.pfnAllocation = &allocationCallback;
+			callbacks.pfnReallocation = &reallocationCallback;
+			callbacks.pfnFree = &freeCallback;
+			callbacks.pfnInternalAllocation = &internalAllocationCallback;
+			callbacks.pfnInternalFree = &internalFreeCallback;
+		}
+
+		HostAllocationTracker(const HostAllocationTracker&) = delete;
+		HostAllocationTracker& operator=(const HostAllocationTracker&) = delete;
+
+		// pass to every vkCreate*/vkDestroy* call, create and destroy of an object need the same callbacks
+		const VkAllocationCallbacks* get() const {
+			return &callbacks;
+		}
+
+		HostAllocationStats getStats(VkSystemAllocationScope scope) const {
+			const ScopeCounters& counters = scopes[scope];
+
+			HostAllocationStats stats;
+			stats.allocations = counters.allocations.load(std::memory_order_relaxed);
+			stats.frees = counters.frees.load(std::memory_order_relaxed);
+			stats.internalAllocations = counters.internalAllocations.load(std::memory_order_relaxed);
+			stats.allocatedBytes = counters.allocatedBytes.load(std::memory_order_relaxed);
+			stats.currentBytes = counters.currentBytes.load(std::memory_order_relaxed);
+			stats.peakBytes = counters.peakBytes.load(std::memory_order_relaxed);
+			return stats;
+		}
+
+		// allocations of all scopes, e.g. to take the difference over one frame
+		uint64_t getTotalAllocations() const {
+			uint64_t total = 0;
+			for (const auto& counters : scopes) {
+				total += counters.allocations.load(std::memory_order_relaxed) + counters.internalAllocations.load(std::memory_order_relaxed);
+			}
+			return total;
+		}
+
+		void printStats() const {
+			static const char* scopeNames[] = { "command", "object", "cache", "device", "instance" };
+
+			std::cout << "driver host allocations:\n";
+			for (uint32_t i = 0; i < scopeCount; i++) {
+				HostAllocationStats stats = getStats(static_cast<VkSystemAllocationScope>(i));
+				std::cout << '\t' << scopeNames[i] << ": " << stats.allocations << " allocations, " << stats.frees << " frees, "
+					<< stats.internalAllocations << " internal, " << stats.allocatedBytes << " bytes total, "
+					<< stats.currentBytes << " bytes live, " << stats.peakBytes << " bytes peak\n";
+			}
+		}
+
+	private:
+
+		struct ScopeCounters {
+			std::atomic<uint64_t> allocations{ 0 };
+			std::atomic<uint64_t> frees{ 0 };
+			std::atomic<uint64_t> internalAllocations{ 0 };
+			std::atomic<uint64_t> allocatedBytes{ 0 };
+			std::atomic<uint64_t> currentBytes{ 0 };
+			std::atomic<uint64_t> peakBytes{ 0 };
+		};
+
+		// stored in front of every block, the free callback gets no size
+		struct Header {
+			size_t size;
+			size_t offset; // from the start of the raw allocation to the user pointer
+			VkSystemAllocationScope scope;
+		};
+
+		VkAllocationCallbacks callbacks{};
+		std::array<ScopeCounters, scopeCount> scopes;
+
+		static Header* headerOf(void* memory) {
+			return reinterpret_cast<Header*>(static_cast<char*>(memory) - sizeof(Header));
+		}
+
+		void* allocate(size_t size, size_t alignment, VkSystemAllocationScope scope) {
+			alignment = std::max(alignment, alignof(Header));
+
+			// header sits right before the aligned user pointer
+			size_t offset = (sizeof(Header) + alignment - 1) / alignment * alignment;
+			char* raw = static_cast<char*>(std::malloc(size + offset + alignment));
+			if (raw == nullptr) {
+				return nullptr;
+			}
+
+			uintptr_t aligned = (reinterpret_cast<uintptr_t>(raw) + offset + alignment - 1) / alignment * alignment;
+			char* memory = reinterpret_cast<char*>(aligned);
+
+			Header* header = headerOf(memory);
+			header->size = size;
+			header->offset = static_cast<size_t>(memory - raw);
+			header->scope = scope;
+
+			ScopeCounters& counters = scopes[scope];
+			counters.allocations.fetch_add(1, std::memory_order_relaxed);
+			counters.allocatedBytes.fetch_add(size, std::memory_order_relaxed);
+			uint64_t current = counters.currentBytes.fetch_add(size, std::memory_order_relaxed) + size;
+
+			uint64_t peak = counters.peakBytes.load(std::memory_order_relaxed);
+			while (current > peak && !counters.peakBytes.compare_exchange_weak(peak, current, std::memory_order_relaxed)) {
+			}
+
+			return memory;
+		}
+
+		void free(void* memory) {
+			if (memory == nullptr) {
+				return;
+			}
+
+			Header* header = headerOf(memory);
+			ScopeCounters& counters = scopes[header->scope];
+			counters.frees.fetch_add(1, std::memory_order_relaxed);
+			counters.currentBytes.fetch_sub(header->size, std::memory_order_relaxed);
+
+			std::free(static_cast<char*>(memory) - header->offset);
+		}
+
+		static VKAPI_ATTR void* VKAPI_CALL allocationCallback(void* pUserData, size_t size, size_t alignment, VkSystemAllocationScope allocationScope) {
+			return static_cast<HostAllocationTracker*>(pUserData)->allocate(size, alignment, allocationScope);
+		}
+
+		static VKAPI_ATTR void* VKAPI_CALL reallocationCallback(void* pUserData, void* pOriginal, size_t size, size_t alignment, VkSystemAllocationScope allocationScope) {
+			HostAllocationTracker* tracker = static_cast<HostAllocationTracker*>(pUserData);
+
+			if (pOriginal == nullptr) {
+				return tracker->allocate(size, alignment, allocationScope);
+			}
+
+			if (size == 0) {
+				tracker->free(pOriginal);
+				return nullptr;
+			}
+
+			void* memory = tracker->allocate(size, alignment, allocationScope);
+			if (memory == nullptr) {
+				return nullptr; // original stays valid
+			}
+
+			std::memcpy(memory, pOriginal, std::min(size, headerOf(pOriginal)->size));
+			tracker->free(pOriginal);
+			return memory;
+		}
+
+		static VKAPI_ATTR void VKAPI_CALL freeCallback(void* pUserData, void* pMemory) {
+			static_cast<HostAllocationTracker*>(pUserData)->free(pMemory);
+		}
+
+		static VKAPI_ATTR void VKAPI_CALL internalAllocationCallback(void* pUserData, size_t size, VkInternalAllocationType /*allocationType*/, VkSystemAllocationScope allocationScope) {
+			ScopeCounters& counters = static_cast<HostAllocationTracker*>(pUserData)->scopes[allocationScope];
+			counters.internalAllocations.fetch_add(1, std::memory_order_relaxed);
+			counters.allocatedBytes.fetch_add(size, std::memory_order_relaxed);
+			counters.currentBytes.fetch_add(size, std::memory_order_relaxed);
+		}
+
+		static VKAPI_ATTR void VKAPI_CALL internalFreeCallback(void* pUserData, size_t size, VkInternalAllocationType /*allocationType*/, VkSystemAllocationScope allocationScope) {
+			ScopeCounters& counters = static_cast<HostAllocationTracker*>(pUserData)->scopes[allocationScope];
+			counters.currentBytes.fetch_sub(size, std::memory_order_relaxed);
+		}
+
+	};
+
+}
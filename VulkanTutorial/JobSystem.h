@@ -0,0 +1,365 @@
+#pragma once
+
+#include <cstdlib>
+#include <cstdint>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <functional>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <exception>
+#include <algorithm>
+#include <stdexcept>
+
+namespace CustomVulkanUtils {
+
+	struct Job {
+		std::function<void()> task;
+		std::atomic<int32_t> pendingDependencies{ 1 }; // one extra reference that is released by submit()
+		std::atomic<bool> finished{ false };
+
+		std::mutex mutex; // guards continuations and exception
+		std::vector<std::shared_ptr<Job>> continuations; // jobs that wait for this one
+		std::exception_ptr exception; // own exception or the one of a failed dependency, rethrown in wait()
+	};
+
+	typedef std::shared_ptr<Job> JobHandle;
+
+
+	// Work stealing scheduler: every worker owns a deque, takes its own newest job (LIFO, cache friendly)
+	// and steals the oldest job of another worker when it runs dry.
+	class JobSystem {
+	public:
+
+		JobSystem() {}
+
+		~JobSystem() {
+			shutdown();
+		}
+
+		JobSystem(const JobSystem&) = delete;
+		JobSystem& operator=(const JobSystem&) = delete;
+
+		// workerCount 0: one worker per hardware thread, minus the calling thread that helps in wait()
+		void init(uint32_t workerCount = 0) {
+			if (running) {
+				return;
+			}
+
+			if (workerCount == 0) {
+				uint32_t hardwareThreads = std::thread::hardware_concurrency();
+				workerCount = hardwareThreads > 1 ? hardwareThreads - 1 : 1;
+			}
+
+			queues.clear();
+			for (uint32_t i = 0; i < workerCount; i++) {
+				queues.push_back(std::make_unique<WorkerQueue>());
+			}
+
+			running = true;
+			for (uint32_t i = 0; i < workerCount; i++) {
+				workers.emplace_back(&JobSystem::workerLoop, this, i);
+			}
+		}
+
+		// stop all workers, jobs that did not start yet are dropped
+		void shutdown() {
+			if (!running) {
+				return;
+			}
+
+			{
+				std::lock_guard<std::mutex> lock(sleepMutex);
+				running = false;
+			}
+			wakeCondition.notify_all();
+			waitCondition.notify_all();
+
+			for (auto& worker : workers) {
+				worker.join();
+			}
+
+			workers.clear();
+			queues.clear();
+			queuedJobs = 0;
+		}
+
+		JobHandle createJob(std::function<void()> task) {
+			JobHandle job = std::make_shared<Job>();
+			job->task = std::move(task);
+			return job;
+		}
+
+		// job does not start before dependency finished. Has to be called before job is submitted
+		void addDependency(const JobHandle& job, const JobHandle& dependency) {
+			std::lock_guard<std::mutex> lock(dependency->mutex);
+
+			if (dependency->finished) {
+				inheritException(job, dependency->exception);
+				return;
+			}
+
+			job->pendingDependencies++;
+			dependency->continuations.push_back(job);
+		}
+
+		// hand the job to the scheduler, it runs as soon as all dependencies are finished
+		void submit(const JobHandle& job) {
+			if (--job->pendingDependencies == 0) {
+				enqueue(job);
+			}
+		}
+
+		// create, wire up and submit a job in one call
+		JobHandle schedule(std::function<void()> task, const std::vector<JobHandle>& dependencies = {}) {
+			JobHandle job = createJob(std::move(task));
+			for (const auto& dependency : dependencies) {
+				addDependency(job, dependency);
+			}
+			submit(job);
+			return job;
+		}
+
+		// block until the job is finished, the calling thread executes other jobs meanwhile. Rethrows exceptions of the job
+		void wait(const JobHandle& job) {
+			waitUntilFinished(job);
+			rethrowException(job);
+		}
+
+		// non-blocking, e.g. for a frame loop that must not stall on a job. wait() afterwards still rethrows its exception
+		bool isFinished(const JobHandle& job) const {
+			return job->finished.load(std::memory_order_acquire);
+		}
+
+		// wait for every job, then rethrow the first exception in the order of jobs. No job is still running afterwards,
+		// so the jobs may reference locals of the caller
+		void waitAll(const std::vector<JobHandle>& jobs) {
+			for (const auto& job : jobs) {
+				waitUntilFinished(job);
+			}
+
+			for (const auto& job : jobs) {
+				rethrowException(job);
+			}
+		}
+
+		// call func(begin, end) for chunks of grainSize indices in parallel and wait for all of them
+		void parallelFor(uint32_t count, uint32_t grainSize, const std::function<void(uint32_t, uint32_t)>& func) {
+			if (count == 0) {
+				return;
+			}
+
+			grainSize = std::max(grainSize, 1u);
+			if (count <= grainSize || !running) {
+				func(0, count);
+				return;
+			}
+
+			// the chunks own a copy of func, nothing depends on the stack frame of the caller
+			auto sharedFunc = std::make_shared<std::function<void(uint32_t, uint32_t)>>(func);
+
+			std::vector<JobHandle> chunks;
+			for (uint32_t begin = 0; begin < count; begin += grainSize) {
+				uint32_t end = std::min(begin + grainSize, count);
+				chunks.push_back(schedule([sharedFunc, begin, end]() { (*sharedFunc)(begin, end); }));
+			}
+
+			waitAll(chunks);
+		}
+
+		uint32_t getWorkerCount() const {
+			return static_cast<uint32_t>(workers.size());
+		}
+
+	private:
+
+		struct WorkerQueue {
+			std::mutex mutex;
+			std::deque<JobHandle> jobs;
+		};
+
+		std::vector<std::unique_ptr<WorkerQueue>> queues; // one per worker
+		std::vector<std::thread> workers;
+		std::atomic<bool> running{ false };
+
+		std::mutex sleepMutex;
+		std::condition_variable wakeCondition; // workers: a job was queued
+		std::condition_variable waitCondition; // threads in wait(): a job finished or one was queued they can help with
+		std::atomic<uint32_t> queuedJobs{ 0 };
+		std::atomic<uint32_t> nextExternalQueue{ 0 }; // round robin for jobs submitted from outside the workers
+
+		struct WorkerIdentity {
+			const JobSystem* owner = nullptr;
+			int32_t index = -1;
+		};
+
+		static WorkerIdentity& workerIdentity() {
+			thread_local WorkerIdentity identity;
+			return identity;
+		}
+
+		void waitUntilFinished(const JobHandle& job) {
+			while (!job->finished.load(std::memory_order_acquire)) {
+				JobHandle next = popOrSteal(currentWorkerIndex());
+				if (next) {
+					execute(next);
+					continue;
+				}
+
+				// nothing to help with: sleep instead of spinning. Also wakes up for new jobs, so a worker waiting
+				// inside a job keeps helping and nested waits cannot starve the queues
+				std::unique_lock<std::mutex> lock(sleepMutex);
+				waitCondition.wait(lock, [&job, this]() { return job->finished.load(std::memory_order_acquire) || queuedJobs > 0; });
+			}
+		}
+
+		static void rethrowException(const JobHandle& job) {
+			std::lock_guard<std::mutex> lock(job->mutex);
+			if (job->exception) {
+				std::rethrow_exception(job->exception);
+			}
+		}
+
+		// index of the worker queue of the calling thread, -1 for threads that do not belong to this job system
+		int32_t currentWorkerIndex() const {
+			const WorkerIdentity& identity = workerIdentity();
+			return identity.owner == this ? identity.index : -1;
+		}
+
+		void enqueue(const JobHandle& job) {
+			if (!running) {
+				throw std::runtime_error("job submitted to a job system that is not running!");
+			}
+
+			int32_t index = currentWorkerIndex();
+			if (index < 0) {
+				index = static_cast<int32_t>(nextExternalQueue++ % queues.size());
+			}
+
+			// count before pushing, so a thief can never decrement below zero.
+			// Under sleepMutex, so no wakeup is lost between the predicate check and the wait of a worker
+			{
+				std::lock_guard<std::mutex> lock(sleepMutex);
+				queuedJobs++;
+			}
+
+			{
+				std::lock_guard<std::mutex> lock(queues[index]->mutex);
+				queues[index]->jobs.push_back(job);
+			}
+			wakeCondition.notify_one();
+			waitCondition.notify_all();
+		}
+
+		JobHandle popOrSteal(int32_t ownIndex) {
+			if (queues.empty()) {
+				return nullptr;
+			}
+
+			// newest job of the own queue
+			if (ownIndex >= 0) {
+				WorkerQueue& queue = *queues[ownIndex];
+				std::lock_guard<std::mutex> lock(queue.mutex);
+				if (!queue.jobs.empty()) {
+					JobHandle job = std::move(queue.jobs.back());
+					queue.jobs.pop_back();
+					queuedJobs--;
+					return job;
+				}
+			}
+
+			// oldest job of someone else
+			uint32_t queueCount = static_cast<uint32_t>(queues.size());
+			uint32_t start = ownIndex >= 0 ? static_cast<uint32_t>(ownIndex) + 1 : 0;
+			for (uint32_t i = 0; i < queueCount; i++) {
+				WorkerQueue& victim = *queues[(start + i) % queueCount];
+				std::lock_guard<std::mutex> lock(victim.mutex);
+				if (!victim.jobs.empty()) {
+					JobHandle job = std::move(victim.jobs.front());
+					victim.jobs.pop_front();
+					queuedJobs--;
+					return job;
+				}
+			}
+
+			return nullptr;
+		}
+
+		void execute(const JobHandle& job) {
+			bool dependencyFailed;
+			{
+				std::lock_guard<std::mutex> lock(job->mutex);
+				dependencyFailed = job->exception != nullptr;
+			}
+
+			// skip the task if something it depends on failed, the exception is passed on instead
+			std::exception_ptr exception;
+			if (!dependencyFailed) {
+				try {
+					job->task();
+				}
+				catch (...) {
+					exception = std::current_exception();
+				}
+			}
+
+			std::vector<JobHandle> continuations;
+			{
+				std::lock_guard<std::mutex> lock(job->mutex);
+				if (exception) {
+					job->exception = exception;
+				}
+				exception = job->exception;
+				continuations.swap(job->continuations);
+				job->finished.store(true, std::memory_order_release);
+			}
+			job->task = nullptr; // release captured state early
+
+			// empty critical section: a waiter is either before its predicate check or already waiting, no lost wakeup
+			{
+				std::lock_guard<std::mutex> lock(sleepMutex);
+			}
+			waitCondition.notify_all();
+
+			for (const auto& continuation : continuations) {
+				inheritException(continuation, exception);
+				if (--continuation->pendingDependencies == 0) {
+					enqueue(continuation);
+				}
+			}
+		}
+
+		static void inheritException(const JobHandle& job, const std::exception_ptr& exception) {
+			if (!exception) {
+				return;
+			}
+
+			std::lock_guard<std::mutex> lock(job->mutex);
+			if (!job->exception) {
+				job->exception = exception;
+			}
+		}
+
+		void workerLoop(uint32_t index) {
+			WorkerIdentity& identity = workerIdentity();
+			identity.owner = this;
+			identity.index = static_cast<int32_t>(index);
+
+			while (running) {
+				JobHandle job = popOrSteal(identity.index);
+				if (job) {
+					execute(job);
+					continue;
+				}
+
+				std::unique_lock<std::mutex> lock(sleepMutex);
+				wakeCondition.wait(lock, [this]() { return !running || queuedJobs > 0; });
+			}
+		}
+
+	};
+
+}
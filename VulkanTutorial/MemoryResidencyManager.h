@@ -0,0 +1,295 @@
+#pragma once
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <cstdlib>
+#include <vector>
+#include <list>
+#include <unordered_map>
+#include <functional>
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+
+namespace CustomVulkanUtils {
+
+	// Resident allocations are never touched by the manager, streamable ones (textures, mesh LODs) can be evicted and reloaded later
+	enum class ResidencyClass {
+		Resident,
+		Streamable
+	};
+
+	typedef uint64_t ResidencyHandle;
+
+	// live numbers of one memory heap
+	struct HeapUsage {
+		VkDeviceSize size = 0; // total size of the heap
+		VkDeviceSize budget = 0; // what this process may use: VK_EXT_memory_budget value or the heap size as fallback
+		VkDeviceSize driverUsage = 0; // usage of this process as reported by the driver (0 without VK_EXT_memory_budget)
+		VkDeviceSize trackedUsage = 0; // sum of all allocations registered with the residency manager
+		uint64_t evictions = 0; // streamable allocations evicted since init
+		VkDeviceSize evictedBytes = 0;
+		bool deviceLocal = false;
+	};
+
+	class MemoryResidencyManager {
+	public:
+
+		MemoryResidencyManager() {
+			this->physicalDevice = VK_NULL_HANDLE;
+		}
+
+		// query the heaps of the device. budgetFraction: start evicting once usage reaches this fraction of the heap budget.
+		// allocator: host allocation callbacks for vkAllocateMemory/vkFreeMemory, nullptr for the driver default
+		void init(VkPhysicalDevice physicalDevice, bool memoryBudgetEnabled, float budgetFraction = 0.9f, const VkAllocationCallbacks* allocator = nullptr) {
+			this->physicalDevice = physicalDevice;
+			this->allocator = allocator;
+			this->memoryBudgetEnabled = memoryBudgetEnabled;
+			setBudgetFraction(budgetFraction);
+
+			vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+
+			heaps.resize(memoryProperties.memoryHeapCount);
+			allocatedSinceQuery.assign(memoryProperties.memoryHeapCount, 0);
+			releasedSinceQuery.assign(memoryProperties.memoryHeapCount, 0);
+			for (uint32_t i = 0; i < memoryProperties.memoryHeapCount; i++) {
+				heaps[i].size = memoryProperties.memoryHeaps[i].size;
+				heaps[i].budget = memoryProperties.memoryHeaps[i].size;
+				heaps[i].deviceLocal = (memoryProperties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) != 0;
+			}
+
+			queryBudget();
+		}
+
+		void setBudgetFraction(float budgetFraction) {
+			if (budgetFraction <= 0.0f || budgetFraction > 1.0f) {
+				throw std::runtime_error("memory budget fraction has to be in (0, 1]!");
+			}
+			this->budgetFraction = budgetFraction;
+		}
+
+		// find a memory type that is allowed by typeFilter (from VkMemoryRequirements) and has all wanted properties
+		uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) const {
+			for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++) {
+				if ((typeFilter & (1 << i)) && (memoryProperties.memoryTypes[i].propertyFlags & properties) == properties) {
+					return i;
+				}
+			}
+
+			throw std::runtime_error("failed to find suitable memory type!");
+		}
+
+		// Evicted resources may still be used by frames in flight. The deferrer gets the evict callback and has to run it once
+		// the GPU is done with everything submitted so far (e.g. TimelineSync::deferRelease). Without one the callback runs
+		// immediately from update()/allocateMemory() and has to defer the free itself.
+		// A deferred eviction is counted as freed right away, but the memory is only returned frames later: it cannot make
+		// room for the allocation that triggered it. That allocation overshoots the limit by up to the evicted size for a
+		// few frames, budgetFraction < 1 has to leave enough headroom for it
+		void setReleaseDeferrer(std::function<void(std::function<void()>)> releaseDeferrer) {
+			this->releaseDeferrer = releaseDeferrer;
+		}
+
+		// register an allocation that was made outside of the manager. evictCallback has to free the resource and its memory
+		ResidencyHandle trackAllocation(uint32_t memoryTypeIndex, VkDeviceSize size, ResidencyClass residencyClass, std::function<void()> evictCallback = nullptr) {
+			if (memoryTypeIndex >= memoryProperties.memoryTypeCount) {
+				throw std::runtime_error("invalid memory type index for tracked allocation!");
+			}
+
+			if (residencyClass == ResidencyClass::Streamable && !evictCallback) {
+				throw std::runtime_error("streamable allocations need an evict callback!");
+			}
+
+			ResidencyHandle handle = nextHandle++;
+
+			Allocation allocation;
+			allocation.heapIndex = memoryProperties.memoryTypes[memoryTypeIndex].heapIndex;
+			allocation.size = size;
+			allocation.residencyClass = residencyClass;
+			allocation.evictCallback = evictCallback;
+
+			if (residencyClass == ResidencyClass::Streamable) {
+				lruList.push_front(handle); // a new resource counts as just used
+				allocation.lruPosition = lruList.begin();
+			}
+
+			heaps[allocation.heapIndex].trackedUsage += size;
+			allocatedSinceQuery[allocation.heapIndex] += size;
+			allocations.emplace(handle, std::move(allocation));
+
+			return handle;
+		}
+
+		// allocate device memory and register it in one step
+		ResidencyHandle allocateMemory(VkDevice device, const VkMemoryRequirements& memRequirements, VkMemoryPropertyFlags properties, VkDeviceMemory& memory, ResidencyClass residencyClass = ResidencyClass::Resident, std::function<void()> evictCallback = nullptr) {
+			uint32_t memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, properties);
+			uint32_t heapIndex = memoryProperties.memoryTypes[memoryTypeIndex].heapIndex;
+
+			// make room before the allocation instead of running into VK_ERROR_OUT_OF_DEVICE_MEMORY.
+			// Only immediate evictions free memory before vkAllocateMemory, deferred ones rely on the headroom (see setReleaseDeferrer)
+			evictUntilBelowLimit(heapIndex, memRequirements.size);
+
+			VkMemoryAllocateInfo allocInfo{};
+			allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+			allocInfo.allocationSize = memRequirements.size;
+			allocInfo.memoryTypeIndex = memoryTypeIndex;
+
+			if (vkAllocateMemory(device, &allocInfo, allocator, &memory) != VK_SUCCESS) {
+				throw std::runtime_error("failed to allocate device memory!");
+			}
+
+			return trackAllocation(memoryTypeIndex, memRequirements.size, residencyClass, evictCallback);
+		}
+
+		void freeMemory(VkDevice device, VkDeviceMemory memory, ResidencyHandle handle) {
+			vkFreeMemory(device, memory, allocator);
+			releaseAllocation(handle);
+		}
+
+		// stop tracking an allocation. Unknown handles (e.g. already evicted) are ignored
+		void releaseAllocation(ResidencyHandle handle) {
+			auto it = allocations.find(handle);
+			if (it == allocations.end()) {
+				return;
+			}
+
+			heaps[it->second.heapIndex].trackedUsage -= it->second.size;
+			releasedSinceQuery[it->second.heapIndex] += it->second.size;
+			if (it->second.residencyClass == ResidencyClass::Streamable) {
+				lruList.erase(it->second.lruPosition);
+			}
+			allocations.erase(it);
+		}
+
+		// mark a resource as used in the current frame
+		void touch(ResidencyHandle handle) {
+			auto it = allocations.find(handle);
+			if (it == allocations.end() || it->second.residencyClass != ResidencyClass::Streamable) {
+				return;
+			}
+
+			lruList.splice(lruList.begin(), lruList, it->second.lruPosition); // move to front, iterators stay valid
+		}
+
+		// call once per frame: refresh budgets and evict least recently used streamable resources on heaps near their budget
+		void update() {
+			queryBudget();
+
+			for (uint32_t heapIndex = 0; heapIndex < heaps.size(); heapIndex++) {
+				evictUntilBelowLimit(heapIndex, 0);
+			}
+		}
+
+		bool isMemoryBudgetEnabled() const {
+			return memoryBudgetEnabled;
+		}
+
+		const std::vector<HeapUsage>& getHeapUsage() const {
+			return heaps;
+		}
+
+		void printHeapUsage() const {
+			std::cout << "memory heaps (" << (memoryBudgetEnabled ? "VK_EXT_memory_budget" : "heap size fallback") << "):\n";
+
+			for (size_t i = 0; i < heaps.size(); i++) {
+				std::cout << '\t' << i << (heaps[i].deviceLocal ? " device local" : " host")
+					<< ": tracked " << toMiB(heaps[i].trackedUsage) << " MiB"
+					<< ", driver " << toMiB(heaps[i].driverUsage) << " MiB"
+					<< ", budget " << toMiB(heaps[i].budget) << " MiB"
+					<< ", size " << toMiB(heaps[i].size) << " MiB"
+					<< ", " << heaps[i].evictions << " evictions (" << toMiB(heaps[i].evictedBytes) << " MiB)\n";
+			}
+		}
+
+	private:
+
+		struct Allocation {
+			uint32_t heapIndex;
+			VkDeviceSize size;
+			ResidencyClass residencyClass;
+			std::function<void()> evictCallback;
+			std::list<ResidencyHandle>::iterator lruPosition; // only valid for streamable allocations
+		};
+
+		VkPhysicalDevice physicalDevice;
+		const VkAllocationCallbacks* allocator = nullptr;
+		VkPhysicalDeviceMemoryProperties memoryProperties{};
+		bool memoryBudgetEnabled = false;
+		float budgetFraction = 0.9f;
+
+		std::vector<HeapUsage> heaps;
+		std::unordered_map<ResidencyHandle, Allocation> allocations;
+		std::list<ResidencyHandle> lruList; // front: most recently used
+		ResidencyHandle nextHandle = 1;
+		std::function<void(std::function<void()>)> releaseDeferrer;
+
+		// driver usage is only refreshed in queryBudget(), these correct it for what happened since then
+		std::vector<VkDeviceSize> allocatedSinceQuery;
+		std::vector<VkDeviceSize> releasedSinceQuery;
+
+		// read the current budget and usage per heap from the driver, if VK_EXT_memory_budget is enabled
+		void queryBudget() {
+			if (!memoryBudgetEnabled) {
+				return;
+			}
+
+			VkPhysicalDeviceMemoryBudgetPropertiesEXT budgetProperties{};
+			budgetProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+
+			VkPhysicalDeviceMemoryProperties2 memoryProperties2{};
+			memoryProperties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+			memoryProperties2.pNext = &budgetProperties;
+
+			vkGetPhysicalDeviceMemoryProperties2(physicalDevice, &memoryProperties2);
+
+			for (size_t i = 0; i < heaps.size(); i++) {
+				heaps[i].budget = budgetProperties.heapBudget[i];
+				heaps[i].driverUsage = budgetProperties.heapUsage[i];
+				allocatedSinceQuery[i] = 0;
+				releasedSinceQuery[i] = 0;
+			}
+		}
+
+		// the driver number also covers memory the manager does not know about (swapchain images etc.)
+		VkDeviceSize currentUsage(uint32_t heapIndex) const {
+			VkDeviceSize driverUsage = heaps[heapIndex].driverUsage + allocatedSinceQuery[heapIndex];
+			driverUsage -= std::min(driverUsage, releasedSinceQuery[heapIndex]);
+			return std::max(driverUsage, heaps[heapIndex].trackedUsage);
+		}
+
+		void evictUntilBelowLimit(uint32_t heapIndex, VkDeviceSize incomingSize) {
+			VkDeviceSize limit = static_cast<VkDeviceSize>(heaps[heapIndex].budget * budgetFraction);
+
+			auto it = lruList.end();
+			while (currentUsage(heapIndex) + incomingSize > limit && it != lruList.begin()) {
+				--it;
+
+				auto allocationIt = allocations.find(*it);
+				if (allocationIt->second.heapIndex != heapIndex) {
+					continue;
+				}
+
+				// remove from tracking before the callback, so a callback that calls freeMemory does not touch the list again
+				Allocation victim = std::move(allocationIt->second);
+				heaps[heapIndex].trackedUsage -= victim.size;
+				heaps[heapIndex].evictions++;
+				heaps[heapIndex].evictedBytes += victim.size;
+				releasedSinceQuery[heapIndex] += victim.size; // counts as freed until the driver reports it
+				allocations.erase(allocationIt);
+				it = lruList.erase(it);
+
+				if (releaseDeferrer) {
+					releaseDeferrer(victim.evictCallback);
+				}
+				else {
+					victim.evictCallback();
+				}
+			}
+		}
+
+		static double toMiB(VkDeviceSize bytes) {
+			return static_cast<double>(bytes) / (1024.0 * 1024.0);
+		}
+
+	};
+
+}
@@ -0,0 +1,430 @@
+#pragma once
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <cstdlib>
+#include <cstdint>
+#include <vector>
+#include <array>
+#include <string>
+#include <cmath>
+#include <algorithm>
+#include <unordered_map>
+#include <fstream>
+#include <stdexcept>
+
+namespace CustomVulkanUtils {
+
+	// same attributes shader.vert has as hard-coded arrays (position, color), position in 3D for the LOD error.
+	// There is no vertex input pipeline yet, the meshes only feed the LOD selection
+	struct Vertex {
+		float pos[3];
+		float color[3];
+
+	};
+
+	struct MeshLod {
+		uint32_t firstIndex; // into Mesh::indices
+		uint32_t indexCount;
+		float error; // max distance of a vertex to its simplified position, in object space
+	};
+
+	// parameters of generateLodChain, stored in the mesh file so a cached file can be checked against the current ones
+	struct LodChainSettings {
+		uint32_t maxLods = 6;
+		float reduction = 0.5f; // triangle count of a level relative to the one before
+
+		bool operator==(const LodChainSettings& other) const {
+			return maxLods == other.maxLods && reduction == other.reduction;
+		}
+
+		bool operator!=(const LodChainSettings& other) const {
+			return !(*this == other);
+		}
+	};
+
+	// All LODs share the vertex buffer, a LOD is only an index range. lods[0] is the full detail mesh
+	struct Mesh {
+		std::vector<Vertex> vertices;
+		std::vector<uint32_t> indices;
+		std::vector<MeshLod> lods;
+		LodChainSettings lodSettings; // what the LOD chain was generated with
+		float boundsCenter[3] = { 0.0f, 0.0f, 0.0f };
+		float boundsRadius = 0.0f;
+	};
+
+
+	// snap all vertices to a grid with resolution^3 cells and keep one vertex per cell (vertex clustering).
+	// Returns the remaining triangles and the largest distance a vertex moved
+	void clusterMeshIndices(const Mesh& mesh, const std::vector<uint32_t>& baseIndices, const float boundsMin[3], float extent, uint32_t resolution,
+		std::vector<uint32_t>& lodIndices, float& error) {
+
+		struct Cluster {
+			float sum[3] = { 0.0f, 0.0f, 0.0f };
+			uint32_t count = 0;
+			uint32_t representative = UINT32_MAX;
+			float representativeDistance = 0.0f;
+		};
+
+		std::unordered_map<uint64_t, uint32_t> cellToCluster;
+		std::vector<Cluster> clusters;
+		std::vector<uint32_t> vertexCluster(mesh.vertices.size());
+
+		for (uint32_t v = 0; v < mesh.vertices.size(); v++) {
+			uint64_t key = 0;
+			for (int axis = 0; axis < 3; axis++) {
+				float cell = (mesh.vertices[v].pos[axis] - boundsMin[axis]) / extent * resolution;
+				uint64_t coordinate = static_cast<uint64_t>(std::clamp(cell, 0.0f, static_cast<float>(resolution - 1)));
+				key = key * resolution + coordinate;
+			}
+
+			auto inserted = cellToCluster.emplace(key, static_cast<uint32_t>(clusters.size()));
+			if (inserted.second) {
+				clusters.emplace_back();
+			}
+
+			Cluster& cluster = clusters[inserted.first->second];
+			for (int axis = 0; axis < 3; axis++) {
+				cluster.sum[axis] += mesh.vertices[v].pos[axis];
+			}
+			cluster.count++;
+			vertexCluster[v] = inserted.first->second;
+		}
+
+		// keep the existing vertex closest to the cluster mean, so no new vertices are needed
+		auto distanceSquared = [](const float a[3], const float b[3]) {
+			float dx = a[0] - b[0], dy = a[1] - b[1], dz = a[2] - b[2];
+			return dx * dx + dy * dy + dz * dz;
+		};
+
+		for (uint32_t v = 0; v < mesh.vertices.size(); v++) {
+			Cluster& cluster = clusters[vertexCluster[v]];
+			float mean[3] = { cluster.sum[0] / cluster.count, cluster.sum[1] / cluster.count, cluster.sum[2] / cluster.count };
+			float distance = distanceSquared(mesh.vertices[v].pos, mean);
+
+			if (cluster.representative == UINT32_MAX || distance < cluster.representativeDistance) {
+				cluster.representative = v;
+				cluster.representativeDistance = distance;
+			}
+		}
+
+		error = 0.0f;
+		for (uint32_t v = 0; v < mesh.vertices.size(); v++) {
+			const Vertex& representative = mesh.vertices[clusters[vertexCluster[v]].representative];
+			error = std::max(error, distanceSquared(mesh.vertices[v].pos, representative.pos));
+		}
+		error = std::sqrt(error);
+
+		// collapsed triangles vanish, triangles that collapsed onto the same cells are kept once
+		std::vector<std::array<uint32_t, 3>> triangles;
+		triangles.reserve(baseIndices.size() / 3);
+
+		for (size_t i = 0; i < baseIndices.size(); i += 3) {
+			uint32_t a = clusters[vertexCluster[baseIndices[i]]].representative;
+			uint32_t b = clusters[vertexCluster[baseIndices[i + 1]]].representative;
+			uint32_t c = clusters[vertexCluster[baseIndices[i + 2]]].representative;
+
+			if (a == b || b == c || a == c) {
+				continue;
+			}
+
+			// rotate the smallest index to the front, keeps the winding
+			if (b < a && b < c) {
+				triangles.push_back({ b, c, a });
+			}
+			else if (c < a && c < b) {
+				triangles.push_back({ c, a, b });
+			}
+			else {
+				triangles.push_back({ a, b, c });
+			}
+		}
+
+		std::sort(triangles.begin(), triangles.end());
+		triangles.erase(std::unique(triangles.begin(), triangles.end()), triangles.end());
+
+		lodIndices.clear();
+		for (const auto& triangle : triangles) {
+			lodIndices.insert(lodIndices.end(), triangle.begin(), triangle.end());
+		}
+	}
+
+	// Offline step: replace mesh.lods with a chain where every level has about reduction times the triangles of the one
+	// before. Expects mesh.indices to hold only the full detail mesh
+	void generateLodChain(Mesh& mesh, const LodChainSettings& settings = LodChainSettings()) {
+		if (mesh.vertices.empty() || mesh.indices.empty() || mesh.indices.size() % 3 != 0) {
+			throw std::runtime_error("cannot generate LODs for an empty or non-triangle mesh!");
+		}
+
+		const uint32_t maxLods = settings.maxLods;
+		const float reduction = settings.reduction;
+		mesh.lodSettings = settings;
+
+		float boundsMin[3] = { mesh.vertices[0].pos[0], mesh.vertices[0].pos[1], mesh.vertices[0].pos[2] };
+		float boundsMax[3] = { boundsMin[0], boundsMin[1], boundsMin[2] };
+		for (const Vertex& vertex : mesh.vertices) {
+			for (int axis = 0; axis < 3; axis++) {
+				boundsMin[axis] = std::min(boundsMin[axis], vertex.pos[axis]);
+				boundsMax[axis] = std::max(boundsMax[axis], vertex.pos[axis]);
+			}
+		}
+
+		float extent = 0.0f;
+		for (int axis = 0; axis < 3; axis++) {
+			mesh.boundsCenter[axis] = 0.5f * (boundsMin[axis] + boundsMax[axis]);
+			extent = std::max(extent, boundsMax[axis] - boundsMin[axis]);
+		}
+		extent = std::max(extent, 1e-6f);
+
+		mesh.boundsRadius = 0.0f;
+		for (const Vertex& vertex : mesh.vertices) {
+			float dx = vertex.pos[0] - mesh.boundsCenter[0], dy = vertex.pos[1] - mesh.boundsCenter[1], dz = vertex.pos[2] - mesh.boundsCenter[2];
+			mesh.boundsRadius = std::max(mesh.boundsRadius, std::sqrt(dx * dx + dy * dy + dz * dz));
+		}
+
+		// every level is simplified from the full detail mesh, so errors do not add up
+		const std::vector<uint32_t> baseIndices = mesh.indices;
+		mesh.lods.clear();
+		mesh.lods.push_back({ 0, static_cast<uint32_t>(baseIndices.size()), 0.0f });
+
+		size_t previousTriangles = baseIndices.size() / 3;
+		uint32_t resolution = std::max(2u, static_cast<uint32_t>(std::sqrt(static_cast<float>(previousTriangles))));
+		std::vector<uint32_t> lodIndices;
+
+		for (uint32_t level = 1; level < maxLods; level++) {
+			float error = 0.0f;
+
+			// coarsen the grid until the triangle count dropped far enough
+			while (true) {
+				clusterMeshIndices(mesh, baseIndices, boundsMin, extent, resolution, lodIndices, error);
+				if (lodIndices.size() / 3 <= previousTriangles * reduction || resolution == 2) {
+					break;
+				}
+				resolution = std::max(2u, resolution * 3 / 4);
+			}
+
+			if (lodIndices.empty() || lodIndices.size() / 3 >= previousTriangles) {
+				break; // nothing left to simplify
+			}
+
+			// the selector relies on the error growing with the level
+			error = std::max(error, mesh.lods.back().error);
+
+			mesh.lods.push_back({ static_cast<uint32_t>(mesh.indices.size()), static_cast<uint32_t>(lodIndices.size()), error });
+			mesh.indices.insert(mesh.indices.end(), lodIndices.begin(), lodIndices.end());
+			previousTriangles = lodIndices.size() / 3;
+		}
+	}
+
+
+	// Binary mesh file with the LOD chain: magic, version, counts, LOD chain settings, bounds, then the arrays
+	const uint32_t meshFileMagic = 0x444F4C4D; // "MLOD"
+	const uint32_t meshFileVersion = 2;
+
+	void writeMesh(const std::string& filename, const Mesh& mesh) {
+		std::ofstream file(filename, std::ios::binary | std::ios::trunc);
+
+		if (!file.is_open()) {
+			throw std::runtime_error("failed to open mesh file for writing!");
+		}
+
+		uint32_t header[5] = { meshFileMagic, meshFileVersion, static_cast<uint32_t>(mesh.vertices.size()),
+			static_cast<uint32_t>(mesh.indices.size()), static_cast<uint32_t>(mesh.lods.size()) };
+
+		file.write(reinterpret_cast<const char*>(header), sizeof(header));
+		file.write(reinterpret_cast<const char*>(&mesh.lodSettings.maxLods), sizeof(mesh.lodSettings.maxLods));
+		file.write(reinterpret_cast<const char*>(&mesh.lodSettings.reduction), sizeof(mesh.lodSettings.reduction));
+		file.write(reinterpret_cast<const char*>(mesh.boundsCenter), sizeof(mesh.boundsCenter));
+		file.write(reinterpret_cast<const char*>(&mesh.boundsRadius), sizeof(mesh.boundsRadius));
+		file.write(reinterpret_cast<const char*>(mesh.vertices.data()), mesh.vertices.size() * sizeof(Vertex));
+		file.write(reinterpret_cast<const char*>(mesh.indices.data()), mesh.indices.size() * sizeof(uint32_t));
+		file.write(reinterpret_cast<const char*>(mesh.lods.data()), mesh.lods.size() * sizeof(MeshLod));
+
+		if (!file) {
+			throw std::runtime_error("failed to write mesh file!");
+		}
+	}
+
+	// throws if the file is truncated or its LOD ranges or indices do not fit the arrays, so a broken file never reaches the GPU
+	Mesh readMesh(const std::string& filename) {
+		std::ifstream file(filename, std::ios::binary | std::ios::ate);
+
+		if (!file.is_open()) {
+			throw std::runtime_error("failed to open mesh file!");
+		}
+
+		uint64_t fileSize = static_cast<uint64_t>(file.tellg());
+		file.seekg(0);
+
+		uint32_t header[5];
+		file.read(reinterpret_cast<char*>(header), sizeof(header));
+		if (!file || header[0] != meshFileMagic || header[1] != meshFileVersion) {
+			throw std::runtime_error("mesh file has an unknown format or version!");
+		}
+
+		Mesh mesh;
+
+		// check the counts against the file size before resizing, a corrupt header must not allocate gigabytes
+		uint64_t expectedSize = sizeof(header) + sizeof(mesh.lodSettings.maxLods) + sizeof(mesh.lodSettings.reduction) + sizeof(mesh.boundsCenter) + sizeof(mesh.boundsRadius)
+			+ uint64_t(header[2]) * sizeof(Vertex) + uint64_t(header[3]) * sizeof(uint32_t) + uint64_t(header[4]) * sizeof(MeshLod);
+		if (fileSize != expectedSize) {
+			throw std::runtime_error("mesh file is truncated!");
+		}
+
+		mesh.vertices.resize(header[2]);
+		mesh.indices.resize(header[3]);
+		mesh.lods.resize(header[4]);
+
+		file.read(reinterpret_cast<char*>(&mesh.lodSettings.maxLods), sizeof(mesh.lodSettings.maxLods));
+		file.read(reinterpret_cast<char*>(&mesh.lodSettings.reduction), sizeof(mesh.lodSettings.reduction));
+		file.read(reinterpret_cast<char*>(mesh.boundsCenter), sizeof(mesh.boundsCenter));
+		file.read(reinterpret_cast<char*>(&mesh.boundsRadius), sizeof(mesh.boundsRadius));
+		file.read(reinterpret_cast<char*>(mesh.vertices.data()), mesh.vertices.size() * sizeof(Vertex));
+		file.read(reinterpret_cast<char*>(mesh.indices.data()), mesh.indices.size() * sizeof(uint32_t));
+		file.read(reinterpret_cast<char*>(mesh.lods.data()), mesh.lods.size() * sizeof(MeshLod));
+
+		if (!file) {
+			throw std::runtime_error("mesh file is truncated!");
+		}
+
+		for (const MeshLod& lod : mesh.lods) {
+			if (uint64_t(lod.firstIndex) + lod.indexCount > mesh.indices.size() || lod.indexCount % 3 != 0) {
+				throw std::runtime_error("mesh file has a LOD outside of the index array!");
+			}
+		}
+
+		for (uint32_t index : mesh.indices) {
+			if (index >= mesh.vertices.size()) {
+				throw std::runtime_error("mesh file has an index outside of the vertex array!");
+			}
+		}
+
+		return mesh;
+	}
+
+	// UV sphere, colored by its normal. Test mesh for the LOD chain until real assets are loaded
+	Mesh createSphereMesh(uint32_t rings, uint32_t segments, float radius) {
+		const float pi = 3.14159265358979f;
+		Mesh mesh;
+
+		for (uint32_t ring = 0; ring <= rings; ring++) {
+			float theta = pi * ring / rings;
+			for (uint32_t segment = 0; segment <= segments; segment++) {
+				float phi = 2.0f * pi * segment / segments;
+				float normal[3] = { std::sin(theta) * std::cos(phi), std::cos(theta), std::sin(theta) * std::sin(phi) };
+
+				Vertex vertex;
+				for (int axis = 0; axis < 3; axis++) {
+					vertex.pos[axis] = normal[axis] * radius;
+					vertex.color[axis] = 0.5f + 0.5f * normal[axis];
+				}
+				mesh.vertices.push_back(vertex);
+			}
+		}
+
+		for (uint32_t ring = 0; ring < rings; ring++) {
+			for (uint32_t segment = 0; segment < segments; segment++) {
+				uint32_t a = ring * (segments + 1) + segment;
+				uint32_t b = a + segments + 1;
+
+				if (ring != 0) { // the triangles at the poles would be degenerate
+					mesh.indices.insert(mesh.indices.end(), { a, a + 1, b });
+				}
+				if (ring != rings - 1) {
+					mesh.indices.insert(mesh.indices.end(), { a + 1, b + 1, b });
+				}
+			}
+		}
+
+		mesh.lods.push_back({ 0, static_cast<uint32_t>(mesh.indices.size()), 0.0f });
+		mesh.boundsRadius = radius;
+		return mesh;
+	}
+
+
+	struct LodInstance {
+		uint32_t mesh; // index into the scene meshes
+		float position[3];
+		float scale = 1.0f;
+		uint32_t lod = 0; // current LOD, kept between frames for the hysteresis
+	};
+
+	struct LodStats {
+		uint64_t triangles = 0; // of the selected LODs
+		uint64_t fullDetailTriangles = 0; // if every instance used LOD 0
+		uint32_t lodSwitches = 0;
+	};
+
+	// Per object LOD selection on the CPU from the screen space error: the coarsest LOD whose error projects to at most
+	// pixelThreshold pixels. The hysteresis band keeps objects near a threshold from switching back and forth (popping)
+	class LodSelector {
+	public:
+
+		void setProjection(float viewportHeight, float fovY) {
+			projectionScale = viewportHeight / (2.0f * std::tan(0.5f * fovY));
+		}
+
+		void setPixelThreshold(float pixelThreshold, float hysteresis = 0.25f) {
+			this->pixelThreshold = pixelThreshold;
+			this->hysteresis = hysteresis;
+		}
+
+		// error of a LOD in pixels at the given distance (to the bounding sphere)
+		float screenSpaceError(const Mesh& mesh, uint32_t lod, float distance, float scale) const {
+			return mesh.lods[lod].error * scale * projectionScale / std::max(distance, 1e-4f);
+		}
+
+		uint32_t select(const Mesh& mesh, float distance, float scale, uint32_t current) const {
+			uint32_t lod = std::min(current, static_cast<uint32_t>(mesh.lods.size()) - 1);
+
+			// coarser only once clearly below the threshold, finer as soon as clearly above
+			while (lod + 1 < mesh.lods.size() && screenSpaceError(mesh, lod + 1, distance, scale) <= pixelThreshold * (1.0f - hysteresis)) {
+				lod++;
+			}
+			while (lod > 0 && screenSpaceError(mesh, lod, distance, scale) > pixelThreshold * (1.0f + hysteresis)) {
+				lod--;
+			}
+
+			return lod;
+		}
+
+		// update the LOD of every instance, with enabled = false every instance stays at full detail
+		LodStats update(const std::vector<Mesh>& meshes, std::vector<LodInstance>& instances, const float cameraPosition[3], bool enabled = true) const {
+			LodStats stats;
+
+			for (LodInstance& instance : instances) {
+				const Mesh& mesh = meshes[instance.mesh];
+				uint32_t lod = 0;
+
+				if (enabled) {
+					float center[3];
+					for (int axis = 0; axis < 3; axis++) {
+						center[axis] = instance.position[axis] + mesh.boundsCenter[axis] * instance.scale;
+					}
+
+					float dx = center[0] - cameraPosition[0], dy = center[1] - cameraPosition[1], dz = center[2] - cameraPosition[2];
+					float distance = std::sqrt(dx * dx + dy * dy + dz * dz) - mesh.boundsRadius * instance.scale;
+					lod = select(mesh, distance, instance.scale, instance.lod);
+				}
+
+				if (lod != instance.lod) {
+					stats.lodSwitches++;
+					instance.lod = lod;
+				}
+
+				stats.triangles += mesh.lods[lod].indexCount / 3;
+				stats.fullDetailTriangles += mesh.lods[0].indexCount / 3;
+			}
+
+			return stats;
+		}
+
+	private:
+
+		float projectionScale = 1.0f;
+		float pixelThreshold = 1.0f;
+		float hysteresis = 0.25f;
+
+	};
+
+}
@@ -8,6 +8,7 @@
 #include <optional> //wrapper that contains no value until we assign something. Can be queried with "has_value()" member function.
 #include <set>
 #include <algorithm>
+#include <cstring>
 
 namespace CustomVulkanUtils {
 
@@ -79,8 +80,10 @@ namespace CustomVulkanUtils {
 			return capabilities.currentExtent;
 		}
 		else {
-			int width, height;
-			glfwGetFramebufferSize(window, &width, &height);
+			int width = 800, height = 600; // headless surfaces (benchmarks) have no window, fall back to the default window size
+			if (window != nullptr) {
+				glfwGetFramebufferSize(window, &width, &height);
+			}
 
 			VkExtent2D actualExtent = {
 				static_cast<uint32_t>(width),
@@ -144,24 +147,39 @@ namespace CustomVulkanUtils {
 	}
 
 	// check if device enables needed extensions (like swapchains)
-	bool checkDeviceExtensionSupport(VkPhysicalDevice device, std::vector<const char*> deviceExtensions) {
+	bool checkDeviceExtensionSupport(VkPhysicalDevice device, const std::vector<const char*>& deviceExtensions) {
 		uint32_t extensionCount;
 		vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
 
 		std::vector<VkExtensionProperties> availableExtensions(extensionCount);
 		vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, availableExtensions.data());
 
-		std::set<std::string> requiredExtensions(deviceExtensions.begin(), deviceExtensions.end());
+		// compare in place instead of building a std::set<std::string> of the required names
+		for (const char* required : deviceExtensions) {
+			bool found = false;
+
+			for (const auto& extension : availableExtensions) {
+				if (strcmp(required, extension.extensionName) == 0) {
+					found = true;
+					break;
+				}
+			}
 
-		for (const auto& extension : availableExtensions) {
-			requiredExtensions.erase(extension.extensionName);
+			if (!found) {
+				return false;
+			}
 		}
 
-		return requiredExtensions.empty();
+		return true;
 	}
 
-	// function to return a score of a graphics card with respect to the options it supports
-	int rateDeviceSuitability(VkPhysicalDevice device, VkSurfaceKHR surface, std::vector<const char*> deviceExtensions) {
+	// check if a single (optional) device extension is available, like VK_EXT_memory_budget
+	bool isDeviceExtensionSupported(VkPhysicalDevice device, const char* extensionName) {
+		return checkDeviceExtensionSupport(device, { extensionName });
+	}
+
+	// score of a graphics card from its type, limits, features and extensions. Shared by the presenting and offscreen rating
+	int rateDeviceCapabilities(VkPhysicalDevice device, const std::vector<const char*>& deviceExtensions) {
 		
 		// Query for device details
 		VkPhysicalDeviceProperties deviceProperties;
@@ -185,14 +203,25 @@ namespace CustomVulkanUtils {
 			return 0;
 		}
 
-		// check if the swapchain suits our needs from the window surface
-		SwapChainSupportDetails swapChainSupport = querySwapChainSupport(device, surface);
-		if (swapChainSupport.formats.empty() || swapChainSupport.presentModes.empty()) {
+		// Application can't function without geometry shaders
+		if (!deviceFeatures.geometryShader) {
 			return 0;
 		}
 
-		// Application can't function without geometry shaders
-		if (!deviceFeatures.geometryShader) {
+		return score;
+	}
+
+	// function to return a score of a graphics card with respect to the options it supports
+	int rateDeviceSuitability(VkPhysicalDevice device, VkSurfaceKHR surface, std::vector<const char*> deviceExtensions) {
+
+		int score = rateDeviceCapabilities(device, deviceExtensions);
+		if (score == 0) {
+			return 0;
+		}
+
+		// check if the swapchain suits our needs from the window surface
+		SwapChainSupportDetails swapChainSupport = querySwapChainSupport(device, surface);
+		if (swapChainSupport.formats.empty() || swapChainSupport.presentModes.empty()) {
 			return 0;
 		}
 
@@ -206,6 +235,61 @@ namespace CustomVulkanUtils {
 	}
 
 
+	// find a queue family with graphics capabilities, without looking at presentation (offscreen devices)
+	std::optional<uint32_t> findGraphicsQueueFamily(VkPhysicalDevice device) {
+		uint32_t queueFamilyCount = 0;
+		vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, nullptr);
+
+		std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+		vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, queueFamilies.data());
+
+		for (uint32_t i = 0; i < queueFamilyCount; i++) {
+			if (queueFamilies[i].queueFlags & VK_QUEUE_GRAPHICS_BIT) {
+				return i;
+			}
+		}
+
+		return std::nullopt;
+	}
+
+	// like rateDeviceSuitability, but for devices that only render offscreen: no surface, swap chain or present queue needed
+	int rateOffscreenDeviceSuitability(VkPhysicalDevice device, std::vector<const char*> deviceExtensions) {
+
+		int score = rateDeviceCapabilities(device, deviceExtensions);
+		if (score == 0) {
+			return 0;
+		}
+
+		if (!findGraphicsQueueFamily(device).has_value()) {
+			return 0;
+		}
+
+		return score;
+	}
+
+	// all graphics cards that can render offscreen, best first
+	std::vector<VkPhysicalDevice> pickOffscreenPhysicalDevices(VkInstance instance, std::vector<const char*> deviceExtensions) {
+
+		uint32_t deviceCount = 0;
+		vkEnumeratePhysicalDevices(instance, &deviceCount, nullptr);
+
+		std::vector<VkPhysicalDevice> devices(deviceCount);
+		vkEnumeratePhysicalDevices(instance, &deviceCount, devices.data());
+
+		std::multimap<int, VkPhysicalDevice> candidates;
+		for (const auto& device : devices) {
+			candidates.insert(std::make_pair(rateOffscreenDeviceSuitability(device, deviceExtensions), device));
+		}
+
+		// keep every suitable candidate instead of only the best one
+		std::vector<VkPhysicalDevice> suitableDevices;
+		for (auto it = candidates.rbegin(); it != candidates.rend() && it->first > 0; ++it) {
+			suitableDevices.push_back(it->second);
+		}
+
+		return suitableDevices;
+	}
+
 	VkPhysicalDevice pickPhysicalDevice(VkInstance instance, VkSurfaceKHR surface, std::vector<const char*> deviceExtensions) {
 
 		VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
@@ -241,7 +325,7 @@ namespace CustomVulkanUtils {
 	}
 
 	// create swapchain with specified parameters for format, presentaionMode, swapExtent
-	VkSwapchainKHR createSwapChain(std::vector<VkImage>& swapChainImages, VkFormat& swapChainImageFormat, VkExtent2D& swapChainExtent, GLFWwindow* window, VkPhysicalDevice device, VkDevice logicalDevice, VkSurfaceKHR surface) {
+	VkSwapchainKHR createSwapChain(std::vector<VkImage>& swapChainImages, VkFormat& swapChainImageFormat, VkExtent2D& swapChainExtent, GLFWwindow* window, VkPhysicalDevice device, VkDevice logicalDevice, VkSurfaceKHR surface, const VkAllocationCallbacks* allocator = nullptr) {
 		SwapChainSupportDetails swapChainSupport = querySwapChainSupport(device, surface);
 
 		VkSurfaceFormatKHR surfaceFormat = chooseSwapSurfaceFormat(swapChainSupport.formats);
@@ -262,6 +346,9 @@ namespace CustomVulkanUtils {
 		createInfo.imageExtent = extent;
 		createInfo.imageArrayLayers = 1;
 		createInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT; // VK_IMAGE_USAGE_TRANSFER_DST_BIT //render images to a separate image first to perform operations like post-processing, then use
+		if (swapChainSupport.capabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_DST_BIT) {
+			createInfo.imageUsage |= VK_IMAGE_USAGE_TRANSFER_DST_BIT; // the frame loop blits the scaled offscreen image into the swap chain image, ScaledRenderTarget::isSupported checks this
+		}
 
 		/*
 		* VK_IMAGE_USAGE_TRANSFER_DST_BIT instead of VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT:
@@ -295,7 +382,7 @@ namespace CustomVulkanUtils {
 		// create swap chain
 		VkSwapchainKHR swapChain;
 
-		if (vkCreateSwapchainKHR(logicalDevice, &createInfo, nullptr, &swapChain) != VK_SUCCESS) {
+		if (vkCreateSwapchainKHR(logicalDevice, &createInfo, allocator, &swapChain) != VK_SUCCESS) {
 			throw std::runtime_error("failed to create swap chain!");
 		}
 
@@ -311,7 +398,7 @@ namespace CustomVulkanUtils {
 		return swapChain;
 	}
 
-	void createImageViews(std::vector<VkImageView>& swapChainImageViews, std::vector<VkImage>& swapChainImages, VkFormat swapChainImageFormat, VkDevice device) {
+	void createImageViews(std::vector<VkImageView>& swapChainImageViews, std::vector<VkImage>& swapChainImages, VkFormat swapChainImageFormat, VkDevice device, const VkAllocationCallbacks* allocator = nullptr) {
 		swapChainImageViews.resize(swapChainImages.size());
 
 		for (size_t i = 0; i < swapChainImages.size(); i++) {
@@ -334,7 +421,7 @@ namespace CustomVulkanUtils {
 			createInfo.subresourceRange.baseArrayLayer = 0;
 			createInfo.subresourceRange.layerCount = 1;
 
-			if (vkCreateImageView(device, &createInfo, nullptr, &swapChainImageViews[i]) != VK_SUCCESS) {
+			if (vkCreateImageView(device, &createInfo, allocator, &swapChainImageViews[i]) != VK_SUCCESS) {
 				throw std::runtime_error("failed to create image views!");
 			}
 
@@ -342,7 +429,8 @@ namespace CustomVulkanUtils {
 
 	}
 
-	VkDevice createLogicalDevice(VkPhysicalDevice physicalDevice, VkSurfaceKHR surface, bool enableValidationLayers, std::vector<const char*> validationLayers, VkQueue& graphicsQueue, VkQueue& presentQueue, std::vector<const char*> deviceExtensions) {
+	// optionalDeviceExtensions are only enabled if the physical device supports them, query with isDeviceExtensionSupported afterwards
+	VkDevice createLogicalDevice(VkPhysicalDevice physicalDevice, VkSurfaceKHR surface, bool enableValidationLayers, std::vector<const char*> validationLayers, VkQueue& graphicsQueue, VkQueue& presentQueue, std::vector<const char*> deviceExtensions, std::vector<const char*> optionalDeviceExtensions = {}, const VkAllocationCallbacks* allocator = nullptr) {
 
 		VkDevice device;
 
@@ -377,9 +465,27 @@ namespace CustomVulkanUtils {
 
 		createInfo.pEnabledFeatures = &deviceFeatures;
 
-		// enable needed devide extensions (like swapchains)
-		createInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
-		createInfo.ppEnabledExtensionNames = deviceExtensions.data();
+		// enable needed devide extensions (like swapchains) and the optional ones the device supports
+		std::vector<const char*> enabledExtensions = deviceExtensions;
+		for (const char* extension : optionalDeviceExtensions) {
+			if (isDeviceExtensionSupported(physicalDevice, extension)) {
+				enabledExtensions.push_back(extension);
+			}
+		}
+
+		createInfo.enabledExtensionCount = static_cast<uint32_t>(enabledExtensions.size());
+		createInfo.ppEnabledExtensionNames = enabledExtensions.data();
+
+		// timeline semaphores are a feature on top of the extension that has to be switched on explicitly
+		VkPhysicalDeviceTimelineSemaphoreFeaturesKHR timelineSemaphoreFeatures{};
+		timelineSemaphoreFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES_KHR;
+		timelineSemaphoreFeatures.timelineSemaphore = VK_TRUE;
+
+		for (const char* extension : enabledExtensions) {
+			if (strcmp(extension, VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME) == 0) {
+				createInfo.pNext = &timelineSemaphoreFeatures;
+			}
+		}
 
 		if (enableValidationLayers) {
 			createInfo.enabledLayerCount = static_cast<uint32_t>(validationLayers.size());
@@ -389,7 +495,7 @@ namespace CustomVulkanUtils {
 			createInfo.enabledLayerCount = 0;
 		}
 
-		if (vkCreateDevice(physicalDevice, &createInfo, nullptr, &device) != VK_SUCCESS) {
+		if (vkCreateDevice(physicalDevice, &createInfo, allocator, &device) != VK_SUCCESS) {
 			throw std::runtime_error("failed to create logical device!");
 		}
 
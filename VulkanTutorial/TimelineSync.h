@@ -0,0 +1,364 @@
+#pragma once
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <cstdlib>
+#include <cstdint>
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <stdexcept>
+
+#include "FrameArena.h"
+
+namespace CustomVulkanUtils {
+
+	// a point on the timeline of one queue: reached once all work submitted up to value is done
+	struct TimelinePoint {
+		uint32_t queue = 0;
+		uint64_t value = 0;
+	};
+
+	struct TimelineSubmitInfo {
+		std::vector<VkCommandBuffer> commandBuffers;
+		std::vector<TimelinePoint> waits; // GPU side waits on other (or the same) timelines
+		std::vector<VkPipelineStageFlags> waitStages; // one per wait, defaults to all commands
+
+		// swap chain acquire/present only work with binary semaphores
+		std::vector<VkSemaphore> binaryWaits;
+		std::vector<VkPipelineStageFlags> binaryWaitStages;
+		std::vector<VkSemaphore> binarySignals;
+	};
+
+
+	// One monotonically increasing timeline semaphore per queue (VK_KHR_timeline_semaphore) instead of a fence and
+	// binary semaphore per frame and queue. CPU and GPU waits are (queue, value) pairs, resources are released
+	// once the timeline value of their last use is reached. Safe to use from several threads (except setFrameArena/cleanup).
+	class TimelineSync {
+	public:
+
+		TimelineSync() {}
+
+		// allocator: host allocation callbacks for the semaphores, nullptr for the driver default
+		void init(VkDevice device, const VkAllocationCallbacks* allocator = nullptr) {
+			this->device = device;
+			this->allocator = allocator;
+
+			waitSemaphoresKHR = (PFN_vkWaitSemaphoresKHR)vkGetDeviceProcAddr(device, "vkWaitSemaphoresKHR");
+			signalSemaphoreKHR = (PFN_vkSignalSemaphoreKHR)vkGetDeviceProcAddr(device, "vkSignalSemaphoreKHR");
+			getSemaphoreCounterValueKHR = (PFN_vkGetSemaphoreCounterValueKHR)vkGetDeviceProcAddr(device, "vkGetSemaphoreCounterValueKHR");
+
+			if (waitSemaphoresKHR == nullptr || signalSemaphoreKHR == nullptr || getSemaphoreCounterValueKHR == nullptr) {
+				throw std::runtime_error("failed to load VK_KHR_timeline_semaphore functions!");
+			}
+		}
+
+		// create the timeline of a queue. Registering the same VkQueue twice (graphics == present) returns the same timeline
+		uint32_t registerQueue(VkQueue queue) {
+			std::lock_guard<std::mutex> lock(mutex);
+
+			for (uint32_t i = 0; i < timelines.size(); i++) {
+				if (timelines[i].queue == queue) {
+					return i;
+				}
+			}
+
+			VkSemaphoreTypeCreateInfoKHR typeInfo{};
+			typeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO_KHR;
+			typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE_KHR;
+			typeInfo.initialValue = 0;
+
+			VkSemaphoreCreateInfo createInfo{};
+			createInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+			createInfo.pNext = &typeInfo;
+
+			Timeline timeline;
+			timeline.queue = queue;
+			if (vkCreateSemaphore(device, &createInfo, allocator, &timeline.semaphore) != VK_SUCCESS) {
+				throw std::runtime_error("failed to create timeline semaphore!");
+			}
+
+			timelines.push_back(std::move(timeline));
+			return static_cast<uint32_t>(timelines.size() - 1);
+		}
+
+		// submit work to a queue, it signals the next value of the queue timeline which is returned
+		TimelinePoint submit(uint32_t queueId, const TimelineSubmitInfo& info) {
+			std::lock_guard<std::mutex> lock(mutex); // vkQueueSubmit needs external synchronisation
+
+			Timeline& timeline = timelines[queueId];
+			uint64_t signalValue = ++timeline.lastSubmitted;
+
+			// transient arrays come from the frame arena if one is set, the submit path then does not touch the heap
+			size_t waitCount = info.waits.size() + info.binaryWaits.size();
+			ArenaVector<VkSemaphore> waitSemaphores{ ArenaAllocator<VkSemaphore>(frameArena) };
+			ArenaVector<uint64_t> waitValues{ ArenaAllocator<uint64_t>(frameArena) };
+			ArenaVector<VkPipelineStageFlags> waitStages{ ArenaAllocator<VkPipelineStageFlags>(frameArena) };
+			waitSemaphores.reserve(waitCount);
+			waitValues.reserve(waitCount);
+			waitStages.reserve(waitCount);
+
+			for (size_t i = 0; i < info.waits.size(); i++) {
+				waitSemaphores.push_back(timelines[info.waits[i].queue].semaphore);
+				waitValues.push_back(info.waits[i].value);
+				waitStages.push_back(i < info.waitStages.size() ? info.waitStages[i] : static_cast<VkPipelineStageFlags>(VK_PIPELINE_STAGE_ALL_COMMANDS_BIT));
+			}
+
+			for (size_t i = 0; i < info.binaryWaits.size(); i++) {
+				waitSemaphores.push_back(info.binaryWaits[i]);
+				waitValues.push_back(0); // ignored for binary semaphores
+				waitStages.push_back(i < info.binaryWaitStages.size() ? info.binaryWaitStages[i] : static_cast<VkPipelineStageFlags>(VK_PIPELINE_STAGE_ALL_COMMANDS_BIT));
+			}
+
+			size_t signalCount = 1 + info.binarySignals.size();
+			ArenaVector<VkSemaphore> signalSemaphores{ ArenaAllocator<VkSemaphore>(frameArena) };
+			ArenaVector<uint64_t> signalValues{ ArenaAllocator<uint64_t>(frameArena) };
+			signalSemaphores.reserve(signalCount);
+			signalValues.reserve(signalCount);
+
+			signalSemaphores.push_back(timeline.semaphore);
+			signalValues.push_back(signalValue);
+			for (VkSemaphore semaphore : info.binarySignals) {
+				signalSemaphores.push_back(semaphore);
+				signalValues.push_back(0);
+			}
+
+			VkTimelineSemaphoreSubmitInfoKHR timelineInfo{};
+			timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO_KHR;
+			timelineInfo.waitSemaphoreValueCount = static_cast<uint32_t>(waitValues.size());
+			timelineInfo.pWaitSemaphoreValues = waitValues.data();
+			timelineInfo.signalSemaphoreValueCount = static_cast<uint32_t>(signalValues.size());
+			timelineInfo.pSignalSemaphoreValues = signalValues.data();
+
+			VkSubmitInfo submitInfo{};
+			submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+			submitInfo.pNext = &timelineInfo;
+			submitInfo.waitSemaphoreCount = static_cast<uint32_t>(waitSemaphores.size());
+			submitInfo.pWaitSemaphores = waitSemaphores.data();
+			submitInfo.pWaitDstStageMask = waitStages.data();
+			submitInfo.commandBufferCount = static_cast<uint32_t>(info.commandBuffers.size());
+			submitInfo.pCommandBuffers = info.commandBuffers.data();
+			submitInfo.signalSemaphoreCount = static_cast<uint32_t>(signalSemaphores.size());
+			submitInfo.pSignalSemaphores = signalSemaphores.data();
+
+			auto start = std::chrono::steady_clock::now();
+			VkResult result = vkQueueSubmit(timeline.queue, 1, &submitInfo, VK_NULL_HANDLE);
+			addSyncTime(start);
+
+			if (result != VK_SUCCESS) {
+				throw std::runtime_error("failed to submit to timeline queue!");
+			}
+
+			return { queueId, signalValue };
+		}
+
+		// advance a timeline from the CPU, e.g. when CPU produced data is ready for the GPU
+		TimelinePoint signalFromHost(uint32_t queueId) {
+			std::lock_guard<std::mutex> lock(mutex);
+
+			Timeline& timeline = timelines[queueId];
+			uint64_t value = ++timeline.lastSubmitted;
+
+			VkSemaphoreSignalInfoKHR signalInfo{};
+			signalInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_SIGNAL_INFO_KHR;
+			signalInfo.semaphore = timeline.semaphore;
+			signalInfo.value = value;
+
+			auto start = std::chrono::steady_clock::now();
+			VkResult result = signalSemaphoreKHR(device, &signalInfo);
+			addSyncTime(start);
+
+			if (result != VK_SUCCESS) {
+				throw std::runtime_error("failed to signal timeline semaphore!");
+			}
+
+			return { queueId, value };
+		}
+
+		// transient arrays of submit/wait are taken from this arena, nullptr: heap.
+		// The arena is not thread safe, only set one if submit and wait are called from the thread that owns it
+		void setFrameArena(FrameArena* frameArena) {
+			this->frameArena = frameArena;
+		}
+
+		// point of the last submission to a queue
+		TimelinePoint lastSubmitted(uint32_t queueId) const {
+			std::lock_guard<std::mutex> lock(mutex);
+			return { queueId, timelines[queueId].lastSubmitted };
+		}
+
+		// non blocking, only asks the driver if the cached value is not far enough yet
+		bool isComplete(const TimelinePoint& point) {
+			std::lock_guard<std::mutex> lock(mutex);
+
+			Timeline& timeline = timelines[point.queue];
+			if (timeline.completed >= point.value) {
+				return true;
+			}
+
+			return refreshCompleted(point.queue) >= point.value;
+		}
+
+		// block the CPU until all points are reached: one call for any number of queues
+		void wait(const std::vector<TimelinePoint>& points, uint64_t timeout = UINT64_MAX) {
+			wait(points.data(), points.size(), timeout);
+		}
+
+		void wait(const TimelinePoint& point, uint64_t timeout = UINT64_MAX) {
+			wait(&point, 1, timeout);
+		}
+
+		void wait(const TimelinePoint* points, size_t pointCount, uint64_t timeout = UINT64_MAX) {
+			ArenaVector<VkSemaphore> semaphores{ ArenaAllocator<VkSemaphore>(frameArena) };
+			ArenaVector<uint64_t> values{ ArenaAllocator<uint64_t>(frameArena) };
+			semaphores.reserve(pointCount);
+			values.reserve(pointCount);
+
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				for (size_t i = 0; i < pointCount; i++) {
+					const TimelinePoint& point = points[i];
+					if (timelines[point.queue].completed < point.value) {
+						semaphores.push_back(timelines[point.queue].semaphore);
+						values.push_back(point.value);
+					}
+				}
+			}
+
+			if (semaphores.empty()) {
+				return;
+			}
+
+			VkSemaphoreWaitInfoKHR waitInfo{};
+			waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO_KHR;
+			waitInfo.semaphoreCount = static_cast<uint32_t>(semaphores.size());
+			waitInfo.pSemaphores = semaphores.data();
+			waitInfo.pValues = values.data();
+
+			// no lock while blocked, other threads keep submitting
+			auto start = std::chrono::steady_clock::now();
+			VkResult result = waitSemaphoresKHR(device, &waitInfo, timeout);
+			addSyncTime(start);
+
+			if (result == VK_TIMEOUT) {
+				throw std::runtime_error("timed out waiting for timeline semaphores!");
+			}
+			if (result != VK_SUCCESS) {
+				throw std::runtime_error("failed to wait for timeline semaphores!");
+			}
+
+			std::lock_guard<std::mutex> lock(mutex);
+			for (size_t i = 0; i < pointCount; i++) {
+				const TimelinePoint& point = points[i];
+				if (timelines[point.queue].completed < point.value) {
+					timelines[point.queue].completed = point.value;
+				}
+			}
+		}
+
+		// release a resource once the GPU is done with it, instead of waiting on a fence of the frame that used it
+		void deferRelease(const TimelinePoint& lastUse, std::function<void()> release) {
+			std::lock_guard<std::mutex> lock(mutex);
+			timelines[lastUse.queue].pendingReleases.push_back({ lastUse.value, std::move(release) });
+		}
+
+		// run all releases whose timeline value is reached. Call once per frame
+		void collect() {
+			std::vector<std::function<void()>> ready;
+
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				for (uint32_t queueId = 0; queueId < timelines.size(); queueId++) {
+					auto& pending = timelines[queueId].pendingReleases;
+					if (pending.empty()) {
+						continue;
+					}
+
+					// values are monotonic, so releases are sorted and we stop at the first one that is not done yet
+					uint64_t completed = timelines[queueId].completed;
+					if (completed < pending.front().value) {
+						completed = refreshCompleted(queueId);
+					}
+
+					while (!pending.empty() && pending.front().value <= completed) {
+						ready.push_back(std::move(pending.front().release));
+						pending.pop_front();
+					}
+				}
+			}
+
+			// outside the lock, a release may defer further releases
+			for (auto& release : ready) {
+				release();
+			}
+		}
+
+		// CPU time spent in submit/signal/wait/query calls since the last call
+		uint64_t consumeSyncTimeNs() {
+			return syncTimeNs.exchange(0);
+		}
+
+		// wait for all queues, run the remaining releases and destroy the semaphores
+		void cleanup() {
+			std::vector<TimelinePoint> points;
+			for (uint32_t i = 0; i < timelines.size(); i++) {
+				points.push_back(lastSubmitted(i));
+			}
+			wait(points);
+			collect();
+
+			std::lock_guard<std::mutex> lock(mutex);
+			for (auto& timeline : timelines) {
+				vkDestroySemaphore(device, timeline.semaphore, allocator);
+			}
+			timelines.clear();
+		}
+
+	private:
+
+		struct PendingRelease {
+			uint64_t value;
+			std::function<void()> release;
+		};
+
+		struct Timeline {
+			VkQueue queue = VK_NULL_HANDLE;
+			VkSemaphore semaphore = VK_NULL_HANDLE;
+			uint64_t lastSubmitted = 0;
+			uint64_t completed = 0; // cached, refreshed lazily
+			std::deque<PendingRelease> pendingReleases;
+		};
+
+		VkDevice device = VK_NULL_HANDLE;
+		const VkAllocationCallbacks* allocator = nullptr;
+		std::vector<Timeline> timelines;
+		mutable std::mutex mutex; // guards timelines, also serialises vkQueueSubmit. Never held during a blocking wait
+		std::atomic<uint64_t> syncTimeNs{ 0 };
+		FrameArena* frameArena = nullptr;
+
+		PFN_vkWaitSemaphoresKHR waitSemaphoresKHR = nullptr;
+		PFN_vkSignalSemaphoreKHR signalSemaphoreKHR = nullptr;
+		PFN_vkGetSemaphoreCounterValueKHR getSemaphoreCounterValueKHR = nullptr;
+
+		// caller holds mutex
+		uint64_t refreshCompleted(uint32_t queueId) {
+			uint64_t value = 0;
+
+			auto start = std::chrono::steady_clock::now();
+			getSemaphoreCounterValueKHR(device, timelines[queueId].semaphore, &value);
+			addSyncTime(start);
+
+			timelines[queueId].completed = value;
+			return value;
+		}
+
+		void addSyncTime(std::chrono::steady_clock::time_point start) {
+			syncTimeNs += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+		}
+
+	};
+
+}
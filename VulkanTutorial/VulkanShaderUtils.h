@@ -29,7 +29,7 @@ namespace CustomVulkanUtils {
 	}
 
 	// wrap shader code into VkShaderModule to be used by the graphics pipeline
-	VkShaderModule createShaderModule(const std::vector<char>& code, VkDevice& device) {
+	VkShaderModule createShaderModule(const std::vector<char>& code, VkDevice& device, const VkAllocationCallbacks* allocator = nullptr) {
 
 		VkShaderModuleCreateInfo createInfo{};
 		createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
@@ -37,7 +37,7 @@ namespace CustomVulkanUtils {
 		createInfo.pCode = reinterpret_cast<const uint32_t*>(code.data());
 
 		VkShaderModule shaderModule;
-		if (vkCreateShaderModule(device, &createInfo, nullptr, &shaderModule) != VK_SUCCESS) {
+		if (vkCreateShaderModule(device, &createInfo, allocator, &shaderModule) != VK_SUCCESS) {
 			throw std::runtime_error("failed to create shader module!");
 		}
 
@@ -0,0 +1,821 @@
+// Microbenchmarks for the CustomVulkanUtils building blocks.
+// Runs without a window on a headless surface (VK_EXT_headless_surface), so it also works on a software driver like lavapipe.
+// Output: one JSON object per line, keys and units stay the same between versions so results can be diffed.
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <iostream>
+#include <fstream>
+#include <stdexcept>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <functional>
+#include <chrono>
+#include <cmath>
+#include <atomic>
+#include <new>
+#include <utility>
+
+#include "PhysicalDeviceUtils.h"
+#include "GraphicsPipelineUtils.h"
+#include "DeviceGroup.h"
+#include "JobSystem.h"
+#include "TimelineSync.h"
+#include "HostAllocationTracker.h"
+#include "FrameArena.h"
+#include "FrameProfiler.h"
+#include "MeshLod.h"
+#include "DynamicResolution.h"
+
+// count every heap allocation of the process, to see what the frame loop costs in heap traffic
+static std::atomic<uint64_t> heapAllocationCount{ 0 };
+
+void* operator new(size_t size) {
+	heapAllocationCount.fetch_add(1, std::memory_order_relaxed);
+	void* memory = std::malloc(size > 0 ? size : 1);
+	if (memory == nullptr) {
+		throw std::bad_alloc();
+	}
+	return memory;
+}
+
+void operator delete(void* memory) noexcept {
+	std::free(memory);
+}
+
+void operator delete(void* memory, size_t) noexcept {
+	std::free(memory);
+}
+
+namespace {
+
+	const uint32_t benchmarkFormatVersion = 1;
+
+	struct BenchmarkResult {
+		std::string name;
+		std::vector<double> samplesUs;
+	};
+
+	// time only the part inside timed(), setup and cleanup around it are not measured
+	class Timer {
+	public:
+		template <typename Func>
+		void timed(Func&& func) {
+			auto start = std::chrono::steady_clock::now();
+			func();
+			auto end = std::chrono::steady_clock::now();
+			elapsedUs = std::chrono::duration<double, std::micro>(end - start).count();
+		}
+
+		double elapsedUs = 0.0;
+	};
+
+	BenchmarkResult runBenchmark(const std::string& name, uint32_t iterations, const std::function<void(Timer&)>& iteration) {
+		BenchmarkResult result;
+		result.name = name;
+
+		Timer warmup;
+		iteration(warmup); // first run pays for driver caches and page faults
+
+		for (uint32_t i = 0; i < iterations; i++) {
+			Timer timer;
+			iteration(timer);
+			result.samplesUs.push_back(timer.elapsedUs);
+		}
+
+		return result;
+	}
+
+	void writeResult(std::ostream& out, const BenchmarkResult& result) {
+		std::vector<double> sorted = result.samplesUs;
+		std::sort(sorted.begin(), sorted.end());
+
+		double sum = 0.0;
+		for (double sample : sorted) {
+			sum += sample;
+		}
+		double mean = sum / sorted.size();
+
+		double variance = 0.0;
+		for (double sample : sorted) {
+			variance += (sample - mean) * (sample - mean);
+		}
+		double stddev = std::sqrt(variance / sorted.size());
+
+		out << "{\"benchmark\":\"" << result.name << "\""
+			<< ",\"iterations\":" << sorted.size()
+			<< ",\"mean_us\":" << mean
+			<< ",\"median_us\":" << sorted[sorted.size() / 2]
+			<< ",\"min_us\":" << sorted.front()
+			<< ",\"max_us\":" << sorted.back()
+			<< ",\"stddev_us\":" << stddev << "}\n";
+	}
+
+	VkInstance createHeadlessInstance() {
+		std::vector<const char*> extensions = {
+			VK_KHR_SURFACE_EXTENSION_NAME,
+			VK_EXT_HEADLESS_SURFACE_EXTENSION_NAME
+		};
+
+		VkApplicationInfo appInfo{};
+		appInfo.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
+		appInfo.pApplicationName = "CustomVulkanUtils Benchmark";
+		appInfo.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
+		appInfo.pEngineName = "No Engine";
+		appInfo.engineVersion = VK_MAKE_VERSION(1, 0, 0);
+		appInfo.apiVersion = VK_API_VERSION_1_1;
+
+		VkInstanceCreateInfo createInfo{};
+		createInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
+		createInfo.pApplicationInfo = &appInfo;
+		createInfo.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
+		createInfo.ppEnabledExtensionNames = extensions.data();
+		createInfo.enabledLayerCount = 0;
+
+		VkInstance instance;
+		if (vkCreateInstance(&createInfo, nullptr, &instance) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create headless instance (is VK_EXT_headless_surface available?)!");
+		}
+
+		return instance;
+	}
+
+	VkSurfaceKHR createHeadlessSurface(VkInstance instance) {
+		auto func = (PFN_vkCreateHeadlessSurfaceEXT)vkGetInstanceProcAddr(instance, "vkCreateHeadlessSurfaceEXT");
+		if (func == nullptr) {
+			throw std::runtime_error("failed to load vkCreateHeadlessSurfaceEXT!");
+		}
+
+		VkHeadlessSurfaceCreateInfoEXT createInfo{};
+		createInfo.sType = VK_STRUCTURE_TYPE_HEADLESS_SURFACE_CREATE_INFO_EXT;
+
+		VkSurfaceKHR surface;
+		if (func(instance, &createInfo, nullptr, &surface) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create headless surface!");
+		}
+
+		return surface;
+	}
+
+	// render the same number of offscreen frames with 1..N devices and report how throughput scales.
+	// Two software devices for local runs: list the lavapipe ICD json twice in VK_ICD_FILENAMES
+	void runMultiDeviceBenchmark(std::ostream& out, VkInstance instance, uint32_t frameCount) {
+		CustomVulkanUtils::JobSystem jobSystem;
+		jobSystem.init();
+
+		const VkExtent2D extent = { 1920, 1080 };
+		const std::vector<const char*> validationLayers;
+		uint32_t availableDevices = static_cast<uint32_t>(CustomVulkanUtils::pickOffscreenPhysicalDevices(instance, {}).size());
+
+		double singleDeviceFps = 0.0;
+		for (uint32_t deviceCount = 1; deviceCount <= availableDevices; deviceCount++) {
+			CustomVulkanUtils::DeviceGroup deviceGroup;
+			deviceGroup.init(instance, false, validationLayers, deviceCount);
+
+			std::vector<CustomVulkanUtils::OffscreenTarget> targets;
+			for (uint32_t i = 0; i < deviceCount; i++) {
+				targets.push_back(CustomVulkanUtils::createOffscreenTarget(deviceGroup.getDevice(i), extent));
+			}
+
+			auto renderFrames = [&](uint32_t frames) {
+				std::vector<CustomVulkanUtils::JobHandle> jobs;
+				for (uint32_t frame = 0; frame < frames; frame++) {
+					CustomVulkanUtils::OffscreenTarget* target = &targets[frame % deviceCount];
+					float shade = static_cast<float>(frame % 256) / 255.0f;
+
+					jobs.push_back(deviceGroup.submitFrame(jobSystem, frame, [target, shade](CustomVulkanUtils::DeviceContext& context) {
+						CustomVulkanUtils::renderOffscreenFrame(context, *target, { { shade, shade, shade, 1.0f } });
+					}));
+				}
+
+				for (const auto& job : jobs) {
+					jobSystem.wait(job);
+				}
+
+				// the jobs only submit, the frames are done once the GPU of every device is
+				for (uint32_t i = 0; i < deviceCount; i++) {
+					CustomVulkanUtils::waitOffscreenTarget(deviceGroup.getDevice(i), targets[i]);
+				}
+			};
+
+			renderFrames(deviceCount); // warmup
+
+			auto start = std::chrono::steady_clock::now();
+			renderFrames(frameCount);
+			double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+			double fps = frameCount / seconds;
+			if (deviceCount == 1) {
+				singleDeviceFps = fps;
+			}
+
+			out << "{\"benchmark\":\"multiDeviceFrames\""
+				<< ",\"devices\":" << deviceCount
+				<< ",\"frames\":" << frameCount
+				<< ",\"width\":" << extent.width
+				<< ",\"height\":" << extent.height
+				<< ",\"frames_per_second\":" << fps
+				<< ",\"scaling\":" << fps / singleDeviceFps << "}\n";
+
+			for (uint32_t i = 0; i < deviceCount; i++) {
+				CustomVulkanUtils::destroyOffscreenTarget(deviceGroup.getDevice(i), targets[i]);
+			}
+		}
+	}
+
+	// heap (operator new) and driver host allocations of a frame that submits to and waits on a timeline,
+	// before (transient arrays on the heap) and after (frame arena)
+	void runFrameAllocationBenchmark(std::ostream& out, VkPhysicalDevice physicalDevice, VkSurfaceKHR surface, uint32_t frameCount) {
+		const std::vector<const char*> deviceExtensions = { VK_KHR_SWAPCHAIN_EXTENSION_NAME };
+		const std::vector<const char*> optionalDeviceExtensions = { VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME };
+		const std::vector<const char*> validationLayers;
+
+		if (!CustomVulkanUtils::isDeviceExtensionSupported(physicalDevice, VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME)) {
+			return;
+		}
+
+		CustomVulkanUtils::HostAllocationTracker hostAllocator;
+		VkQueue graphicsQueue;
+		VkQueue presentQueue;
+		VkDevice device = CustomVulkanUtils::createLogicalDevice(physicalDevice, surface, false, validationLayers, graphicsQueue, presentQueue, deviceExtensions, optionalDeviceExtensions, hostAllocator.get());
+
+		CustomVulkanUtils::FrameArena frameArena;
+		CustomVulkanUtils::TimelineSync timelineSync;
+		timelineSync.init(device);
+		uint32_t graphicsTimeline = timelineSync.registerQueue(graphicsQueue);
+
+		// same submit as the app frame: one command buffer, a binary wait (acquire) and a binary signal (present).
+		// Two binary semaphores take turns, every frame waits on the one the frame before signalled
+		VkCommandPoolCreateInfo poolInfo{};
+		poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+		poolInfo.queueFamilyIndex = CustomVulkanUtils::findQueueFamilies(physicalDevice, surface).graphicsFamily.value();
+
+		VkCommandPool commandPool;
+		if (vkCreateCommandPool(device, &poolInfo, hostAllocator.get(), &commandPool) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create benchmark command pool!");
+		}
+
+		VkCommandBufferAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		allocInfo.commandPool = commandPool;
+		allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+		allocInfo.commandBufferCount = 1;
+
+		VkCommandBuffer commandBuffer;
+		if (vkAllocateCommandBuffers(device, &allocInfo, &commandBuffer) != VK_SUCCESS) {
+			throw std::runtime_error("failed to allocate benchmark command buffer!");
+		}
+
+		VkCommandBufferBeginInfo beginInfo{};
+		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		vkBeginCommandBuffer(commandBuffer, &beginInfo);
+		vkEndCommandBuffer(commandBuffer);
+
+		VkSemaphoreCreateInfo semaphoreInfo{};
+		semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+		VkSemaphore binarySemaphores[2];
+		for (VkSemaphore& semaphore : binarySemaphores) {
+			if (vkCreateSemaphore(device, &semaphoreInfo, hostAllocator.get(), &semaphore) != VK_SUCCESS) {
+				throw std::runtime_error("failed to create benchmark semaphore!");
+			}
+		}
+
+		CustomVulkanUtils::TimelineSubmitInfo primeInfo;
+		primeInfo.binarySignals = { binarySemaphores[0] };
+		timelineSync.wait(timelineSync.submit(graphicsTimeline, primeInfo));
+
+		CustomVulkanUtils::TimelineSubmitInfo submitInfo;
+		submitInfo.commandBuffers = { commandBuffer };
+		submitInfo.binaryWaits = { binarySemaphores[0] };
+		submitInfo.binaryWaitStages = { VK_PIPELINE_STAGE_TRANSFER_BIT };
+		submitInfo.binarySignals = { binarySemaphores[1] };
+
+		for (bool useArena : { false, true }) {
+			timelineSync.setFrameArena(useArena ? &frameArena : nullptr);
+
+			auto frame = [&]() {
+				CustomVulkanUtils::TimelinePoint point = timelineSync.submit(graphicsTimeline, submitInfo);
+				timelineSync.wait(point);
+				timelineSync.collect();
+				frameArena.reset();
+				std::swap(submitInfo.binaryWaits[0], submitInfo.binarySignals[0]);
+			};
+
+			frame(); // warmup
+
+			uint64_t heapBefore = heapAllocationCount.load();
+			uint64_t driverBefore = hostAllocator.getTotalAllocations();
+
+			for (uint32_t i = 0; i < frameCount; i++) {
+				frame();
+			}
+
+			double heapPerFrame = static_cast<double>(heapAllocationCount.load() - heapBefore) / frameCount;
+			double driverPerFrame = static_cast<double>(hostAllocator.getTotalAllocations() - driverBefore) / frameCount;
+
+			out << "{\"benchmark\":\"frameAllocations\""
+				<< ",\"arena\":" << (useArena ? "true" : "false")
+				<< ",\"frames\":" << frameCount
+				<< ",\"heap_allocations_per_frame\":" << heapPerFrame
+				<< ",\"driver_allocations_per_frame\":" << driverPerFrame << "}\n";
+		}
+
+		vkDeviceWaitIdle(device);
+		for (VkSemaphore semaphore : binarySemaphores) {
+			vkDestroySemaphore(device, semaphore, hostAllocator.get());
+		}
+		vkDestroyCommandPool(device, commandPool, hostAllocator.get());
+
+		timelineSync.cleanup();
+		vkDestroyDevice(device, hostAllocator.get());
+	}
+
+	// CPU time of the stages of one frame of the app (acquire, record, submit, present) on the headless swap chain.
+	// Records the same commands as the app: scene pass on the scaled sub-rectangle and the upscale blit.
+	// The wait for the frame is not part of any stage, syncSubmitWaitFence measures that
+	void runFrameLoopBenchmark(std::ostream& out, VkPhysicalDevice physicalDevice, VkSurfaceKHR surface, VkDevice device, VkQueue graphicsQueue, VkQueue presentQueue,
+		VkSwapchainKHR swapChain, const std::vector<VkImage>& swapChainImages, VkFormat swapChainImageFormat, VkExtent2D swapChainExtent, uint32_t iterations) {
+
+		VkImageUsageFlags swapChainUsage = CustomVulkanUtils::querySwapChainSupport(physicalDevice, surface).capabilities.supportedUsageFlags;
+		if (!CustomVulkanUtils::ScaledRenderTarget::isSupported(physicalDevice, swapChainImageFormat, swapChainUsage)) {
+			return;
+		}
+
+		CustomVulkanUtils::MemoryResidencyManager residencyManager;
+		residencyManager.init(physicalDevice, false);
+
+		CustomVulkanUtils::ScaledRenderTarget scaledRenderTarget;
+		scaledRenderTarget.init(physicalDevice, device, residencyManager, swapChainExtent, swapChainImageFormat);
+		VkExtent2D renderExtent = { swapChainExtent.width * 3 / 4, swapChainExtent.height * 3 / 4 }; // a typical reduced scale
+
+		VkCommandPoolCreateInfo poolInfo{};
+		poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+		poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+		poolInfo.queueFamilyIndex = CustomVulkanUtils::findQueueFamilies(physicalDevice, surface).graphicsFamily.value();
+
+		VkCommandPool commandPool;
+		if (vkCreateCommandPool(device, &poolInfo, nullptr, &commandPool) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create benchmark command pool!");
+		}
+
+		VkCommandBufferAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		allocInfo.commandPool = commandPool;
+		allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+		allocInfo.commandBufferCount = 1;
+
+		VkCommandBuffer commandBuffer;
+		if (vkAllocateCommandBuffers(device, &allocInfo, &commandBuffer) != VK_SUCCESS) {
+			throw std::runtime_error("failed to allocate benchmark command buffer!");
+		}
+
+		VkSemaphoreCreateInfo semaphoreInfo{};
+		semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+		VkFenceCreateInfo fenceInfo{};
+		fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+
+		VkSemaphore imageAvailableSemaphore;
+		VkSemaphore renderFinishedSemaphore;
+		VkFence inFlightFence;
+		if (vkCreateSemaphore(device, &semaphoreInfo, nullptr, &imageAvailableSemaphore) != VK_SUCCESS ||
+			vkCreateSemaphore(device, &semaphoreInfo, nullptr, &renderFinishedSemaphore) != VK_SUCCESS ||
+			vkCreateFence(device, &fenceInfo, nullptr, &inFlightFence) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create benchmark frame synchronization objects!");
+		}
+
+		BenchmarkResult acquire{ "frameAcquire", {} };
+		BenchmarkResult record{ "frameRecord", {} };
+		BenchmarkResult submit{ "frameSubmit", {} };
+		BenchmarkResult present{ "framePresent", {} };
+
+		for (uint32_t i = 0; i <= iterations; i++) { // frame 0 is the warmup
+			Timer acquireTimer;
+			Timer recordTimer;
+			Timer submitTimer;
+			Timer presentTimer;
+
+			uint32_t imageIndex;
+			acquireTimer.timed([&] {
+				VkResult result = vkAcquireNextImageKHR(device, swapChain, UINT64_MAX, imageAvailableSemaphore, VK_NULL_HANDLE, &imageIndex);
+				if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR) {
+					throw std::runtime_error("failed to acquire swap chain image!");
+				}
+			});
+
+			recordTimer.timed([&] {
+				vkResetCommandBuffer(commandBuffer, 0);
+
+				VkCommandBufferBeginInfo beginInfo{};
+				beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+				beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+				vkBeginCommandBuffer(commandBuffer, &beginInfo);
+
+				scaledRenderTarget.beginScenePass(commandBuffer, renderExtent, { { 0.1f, 0.2f, 0.4f, 1.0f } });
+				scaledRenderTarget.endScenePass(commandBuffer);
+				scaledRenderTarget.recordUpscale(commandBuffer, renderExtent, swapChainImages[imageIndex], swapChainExtent);
+
+				vkEndCommandBuffer(commandBuffer);
+			});
+
+			submitTimer.timed([&] {
+				VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+
+				VkSubmitInfo submitInfo{};
+				submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+				submitInfo.waitSemaphoreCount = 1;
+				submitInfo.pWaitSemaphores = &imageAvailableSemaphore;
+				submitInfo.pWaitDstStageMask = &waitStage;
+				submitInfo.commandBufferCount = 1;
+				submitInfo.pCommandBuffers = &commandBuffer;
+				submitInfo.signalSemaphoreCount = 1;
+				submitInfo.pSignalSemaphores = &renderFinishedSemaphore;
+
+				vkQueueSubmit(graphicsQueue, 1, &submitInfo, inFlightFence);
+			});
+
+			presentTimer.timed([&] {
+				VkPresentInfoKHR presentInfo{};
+				presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
+				presentInfo.waitSemaphoreCount = 1;
+				presentInfo.pWaitSemaphores = &renderFinishedSemaphore;
+				presentInfo.swapchainCount = 1;
+				presentInfo.pSwapchains = &swapChain;
+				presentInfo.pImageIndices = &imageIndex;
+
+				vkQueuePresentKHR(presentQueue, &presentInfo);
+			});
+
+			// one frame in flight like the app, so the command buffer can be re-recorded
+			vkWaitForFences(device, 1, &inFlightFence, VK_TRUE, UINT64_MAX);
+			vkResetFences(device, 1, &inFlightFence);
+
+			if (i > 0) {
+				acquire.samplesUs.push_back(acquireTimer.elapsedUs);
+				record.samplesUs.push_back(recordTimer.elapsedUs);
+				submit.samplesUs.push_back(submitTimer.elapsedUs);
+				present.samplesUs.push_back(presentTimer.elapsedUs);
+			}
+		}
+
+		vkQueueWaitIdle(presentQueue);
+
+		writeResult(out, acquire);
+		writeResult(out, record);
+		writeResult(out, submit);
+		writeResult(out, present);
+
+		vkDestroyFence(device, inFlightFence, nullptr);
+		vkDestroySemaphore(device, renderFinishedSemaphore, nullptr);
+		vkDestroySemaphore(device, imageAvailableSemaphore, nullptr);
+		vkDestroyCommandPool(device, commandPool, nullptr);
+		scaledRenderTarget.cleanup();
+	}
+
+	// the same per element work once serial and once split into chunks by JobSystem::parallelFor,
+	// the ratio of the means is the speedup (and the scheduling overhead for small grains)
+	void runParallelForBenchmark(std::ostream& out, uint32_t iterations) {
+		CustomVulkanUtils::JobSystem jobSystem;
+		jobSystem.init();
+
+		const uint32_t count = 1 << 20;
+		std::vector<float> values(count);
+		auto work = [&values](uint32_t begin, uint32_t end) {
+			for (uint32_t i = begin; i < end; i++) {
+				values[i] = std::sqrt(static_cast<float>(i)) * std::sin(static_cast<float>(i));
+			}
+		};
+
+		writeResult(out, runBenchmark("serialFor1M", iterations, [&](Timer& timer) {
+			timer.timed([&]() { work(0, count); });
+		}));
+
+		for (uint32_t grainSize : { 1u << 12, 1u << 16 }) {
+			writeResult(out, runBenchmark("parallelFor1MGrain" + std::to_string(grainSize), iterations, [&](Timer& timer) {
+				timer.timed([&]() { jobSystem.parallelFor(count, grainSize, work); });
+			}));
+		}
+	}
+
+	// drive LRU eviction with a small budget fraction: 48 streamable allocations against a limit of 32, the 16 least recently
+	// used ones have to go, in LRU order. Sizes are only tracked, no device memory is allocated. Throws if order or usage is wrong
+	void runResidencyBenchmark(std::ostream& out, VkPhysicalDevice physicalDevice) {
+		const uint32_t allocationCount = 48;
+		const uint32_t fittingCount = 32;
+		const uint32_t touchedCount = 16; // the oldest ones are used again and must survive
+
+		for (bool deferred : { false, true }) {
+			CustomVulkanUtils::MemoryResidencyManager residencyManager;
+			residencyManager.init(physicalDevice, false, 0.05f);
+
+			std::vector<std::function<void()>> pendingReleases;
+			if (deferred) {
+				residencyManager.setReleaseDeferrer([&pendingReleases](std::function<void()> release) { pendingReleases.push_back(release); });
+			}
+
+			VkPhysicalDeviceMemoryProperties memoryProperties;
+			vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+			uint32_t memoryTypeIndex = residencyManager.findMemoryType(~0u, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+			uint32_t heapIndex = memoryProperties.memoryTypes[memoryTypeIndex].heapIndex;
+
+			VkDeviceSize limit = static_cast<VkDeviceSize>(residencyManager.getHeapUsage()[heapIndex].budget * 0.05f);
+			VkDeviceSize size = limit / fittingCount;
+
+			std::vector<CustomVulkanUtils::ResidencyHandle> handles;
+			std::vector<uint32_t> evicted; // allocation numbers in eviction order
+			for (uint32_t i = 0; i < allocationCount; i++) {
+				handles.push_back(residencyManager.trackAllocation(memoryTypeIndex, size, CustomVulkanUtils::ResidencyClass::Streamable, [&evicted, i]() {
+					evicted.push_back(i);
+				}));
+			}
+
+			for (uint32_t i = 0; i < touchedCount; i++) {
+				residencyManager.touch(handles[i]);
+			}
+
+			auto start = std::chrono::steady_clock::now();
+			residencyManager.update();
+			double updateUs = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+
+			// deferred: nothing is freed yet, the usage already counts the evictions as done
+			bool deferredOk = !deferred || evicted.empty();
+			for (auto& release : pendingReleases) {
+				release();
+			}
+
+			// expected victims: the untouched allocations, oldest first
+			std::vector<uint32_t> expected;
+			for (uint32_t i = touchedCount; i < touchedCount + (allocationCount - fittingCount); i++) {
+				expected.push_back(i);
+			}
+			const CustomVulkanUtils::HeapUsage& heap = residencyManager.getHeapUsage()[heapIndex];
+			bool lruOrderOk = evicted == expected && deferredOk;
+			bool usageOk = heap.trackedUsage == fittingCount * size && heap.trackedUsage <= limit && heap.evictions == evicted.size();
+
+			out << "{\"benchmark\":\"residencyEviction\""
+				<< ",\"deferred\":" << (deferred ? "true" : "false")
+				<< ",\"allocations\":" << allocationCount
+				<< ",\"evicted\":" << evicted.size()
+				<< ",\"limit_bytes\":" << limit
+				<< ",\"tracked_bytes\":" << heap.trackedUsage
+				<< ",\"lru_order_ok\":" << (lruOrderOk ? "true" : "false")
+				<< ",\"usage_ok\":" << (usageOk ? "true" : "false")
+				<< ",\"update_us\":" << updateUs << "}\n";
+
+			if (!lruOrderOk || !usageOk) {
+				throw std::runtime_error("residency manager evicted the wrong allocations!");
+			}
+		}
+	}
+
+	// LOD chain of the test mesh and triangles per frame of a 32 x 32 object grid with and without LOD selection
+	void runLodBenchmark(std::ostream& out, uint32_t iterations) {
+		writeResult(out, runBenchmark("generateLodChain", iterations, [&](Timer& timer) {
+			CustomVulkanUtils::Mesh mesh = CustomVulkanUtils::createSphereMesh(64, 128, 1.0f);
+			timer.timed([&]() {
+				CustomVulkanUtils::generateLodChain(mesh);
+			});
+		}));
+
+		std::vector<CustomVulkanUtils::Mesh> meshes = { CustomVulkanUtils::createSphereMesh(64, 128, 1.0f) };
+		CustomVulkanUtils::generateLodChain(meshes[0]);
+
+		for (uint32_t lod = 0; lod < meshes[0].lods.size(); lod++) {
+			out << "{\"benchmark\":\"lodChain\""
+				<< ",\"lod\":" << lod
+				<< ",\"triangles\":" << meshes[0].lods[lod].indexCount / 3
+				<< ",\"error\":" << meshes[0].lods[lod].error << "}\n";
+		}
+
+		CustomVulkanUtils::LodSelector lodSelector;
+		lodSelector.setProjection(1080.0f, 0.785f);
+
+		const uint32_t frameCount = iterations * 10;
+		for (bool enableLod : { false, true }) {
+			std::vector<CustomVulkanUtils::LodInstance> instances;
+			for (uint32_t x = 0; x < 32; x++) {
+				for (uint32_t z = 0; z < 32; z++) {
+					CustomVulkanUtils::LodInstance gridInstance;
+					gridInstance.mesh = 0;
+					gridInstance.position[0] = x * 4.0f;
+					gridInstance.position[1] = 0.0f;
+					gridInstance.position[2] = z * 4.0f;
+					instances.push_back(gridInstance);
+				}
+			}
+
+			uint64_t triangles = 0;
+			uint64_t lodSwitches = 0;
+
+			auto start = std::chrono::steady_clock::now();
+			for (uint32_t frame = 0; frame < frameCount; frame++) {
+				float angle = frame * 0.002f;
+				float cameraPosition[3] = { 62.0f + 70.0f * std::cos(angle), 10.0f, 62.0f + 70.0f * std::sin(angle) };
+
+				CustomVulkanUtils::LodStats stats = lodSelector.update(meshes, instances, cameraPosition, enableLod);
+				triangles += stats.triangles;
+				lodSwitches += stats.lodSwitches;
+			}
+			double selectionUs = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+
+			out << "{\"benchmark\":\"lodSelection\""
+				<< ",\"lod\":" << (enableLod ? "true" : "false")
+				<< ",\"objects\":" << instances.size()
+				<< ",\"frames\":" << frameCount
+				<< ",\"triangles_per_frame\":" << triangles / frameCount
+				<< ",\"lod_switches_per_frame\":" << static_cast<double>(lodSwitches) / frameCount
+				<< ",\"selection_us_per_frame\":" << selectionUs / frameCount << "}\n";
+		}
+	}
+
+	struct Options {
+		uint32_t iterations = 50;
+		std::string outputPath; // empty: stdout
+	};
+
+	Options parseOptions(int argc, char** argv) {
+		Options options;
+
+		for (int i = 1; i < argc; i++) {
+			if (strcmp(argv[i], "--iterations") == 0 && i + 1 < argc) {
+				options.iterations = static_cast<uint32_t>(std::max(1, std::atoi(argv[++i])));
+			}
+			else if (strcmp(argv[i], "--output") == 0 && i + 1 < argc) {
+				options.outputPath = argv[++i];
+			}
+			else {
+				throw std::runtime_error(std::string("unknown argument: ") + argv[i] + " (usage: [--iterations N] [--output file])");
+			}
+		}
+
+		return options;
+	}
+
+}
+
+int main(int argc, char** argv) {
+
+	try {
+		Options options = parseOptions(argc, argv);
+
+		std::ofstream outputFile;
+		if (!options.outputPath.empty()) {
+			outputFile.open(options.outputPath, std::ios::out | std::ios::trunc);
+			if (!outputFile.is_open()) {
+				throw std::runtime_error("failed to open benchmark output file!");
+			}
+		}
+		std::ostream& out = options.outputPath.empty() ? std::cout : outputFile;
+
+		const std::vector<const char*> deviceExtensions = { VK_KHR_SWAPCHAIN_EXTENSION_NAME };
+		const std::vector<const char*> validationLayers;
+
+		VkInstance instance = createHeadlessInstance();
+		VkSurfaceKHR surface = createHeadlessSurface(instance);
+
+		VkPhysicalDevice physicalDevice = CustomVulkanUtils::pickPhysicalDevice(instance, surface, deviceExtensions);
+
+		VkPhysicalDeviceProperties deviceProperties;
+		vkGetPhysicalDeviceProperties(physicalDevice, &deviceProperties);
+
+		out << "{\"format_version\":" << benchmarkFormatVersion
+			<< ",\"device\":\"" << deviceProperties.deviceName << "\""
+			<< ",\"driver_version\":" << deviceProperties.driverVersion
+			<< ",\"api_version\":" << deviceProperties.apiVersion << "}\n";
+
+		writeResult(out, runBenchmark("pickPhysicalDevice", options.iterations, [&](Timer& timer) {
+			timer.timed([&] { CustomVulkanUtils::pickPhysicalDevice(instance, surface, deviceExtensions); });
+		}));
+
+		VkQueue graphicsQueue;
+		VkQueue presentQueue;
+
+		writeResult(out, runBenchmark("createLogicalDevice", options.iterations, [&](Timer& timer) {
+			VkDevice device;
+			timer.timed([&] { device = CustomVulkanUtils::createLogicalDevice(physicalDevice, surface, false, validationLayers, graphicsQueue, presentQueue, deviceExtensions); });
+			vkDestroyDevice(device, nullptr);
+		}));
+
+		// the remaining benchmarks share one logical device
+		const std::vector<const char*> optionalDeviceExtensions = { VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME };
+		VkDevice device = CustomVulkanUtils::createLogicalDevice(physicalDevice, surface, false, validationLayers, graphicsQueue, presentQueue, deviceExtensions, optionalDeviceExtensions);
+
+		std::vector<VkImage> swapChainImages;
+		VkFormat swapChainImageFormat;
+		VkExtent2D swapChainExtent;
+
+		writeResult(out, runBenchmark("createSwapChain", options.iterations, [&](Timer& timer) {
+			VkSwapchainKHR swapChain;
+			timer.timed([&] { swapChain = CustomVulkanUtils::createSwapChain(swapChainImages, swapChainImageFormat, swapChainExtent, nullptr, physicalDevice, device, surface); });
+			vkDestroySwapchainKHR(device, swapChain, nullptr);
+		}));
+
+		VkSwapchainKHR swapChain = CustomVulkanUtils::createSwapChain(swapChainImages, swapChainImageFormat, swapChainExtent, nullptr, physicalDevice, device, surface);
+
+		writeResult(out, runBenchmark("createImageViews", options.iterations, [&](Timer& timer) {
+			std::vector<VkImageView> swapChainImageViews;
+			timer.timed([&] { CustomVulkanUtils::createImageViews(swapChainImageViews, swapChainImages, swapChainImageFormat, device); });
+			for (auto imageView : swapChainImageViews) {
+				vkDestroyImageView(device, imageView, nullptr);
+			}
+		}));
+
+		writeResult(out, runBenchmark("readFile", options.iterations, [&](Timer& timer) {
+			timer.timed([&] { CustomVulkanUtils::readFile("shaders/vert.spv"); });
+		}));
+
+		auto vertShaderCode = CustomVulkanUtils::readFile("shaders/vert.spv");
+
+		writeResult(out, runBenchmark("createShaderModule", options.iterations, [&](Timer& timer) {
+			VkShaderModule shaderModule;
+			timer.timed([&] { shaderModule = CustomVulkanUtils::createShaderModule(vertShaderCode, device); });
+			vkDestroyShaderModule(device, shaderModule, nullptr);
+		}));
+
+		writeResult(out, runBenchmark("createGraphicsPipeline", options.iterations, [&](Timer& timer) {
+			timer.timed([&] { CustomVulkanUtils::createGraphicsPipeline(device); });
+		}));
+
+		// CPU cost of synchronising with the GPU once per frame: fence (baseline) against timeline semaphore
+		VkFenceCreateInfo fenceInfo{};
+		fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+
+		VkFence fence;
+		if (vkCreateFence(device, &fenceInfo, nullptr, &fence) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create benchmark fence!");
+		}
+
+		writeResult(out, runBenchmark("syncSubmitWaitFence", options.iterations, [&](Timer& timer) {
+			VkSubmitInfo submitInfo{};
+			submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+
+			timer.timed([&] {
+				vkQueueSubmit(graphicsQueue, 1, &submitInfo, fence);
+				vkWaitForFences(device, 1, &fence, VK_TRUE, UINT64_MAX);
+				vkResetFences(device, 1, &fence);
+			});
+		}));
+
+		vkDestroyFence(device, fence, nullptr);
+
+		if (CustomVulkanUtils::isDeviceExtensionSupported(physicalDevice, VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME)) {
+			CustomVulkanUtils::TimelineSync timelineSync;
+			timelineSync.init(device);
+			uint32_t graphicsTimeline = timelineSync.registerQueue(graphicsQueue);
+
+			writeResult(out, runBenchmark("syncSubmitWaitTimeline", options.iterations, [&](Timer& timer) {
+				CustomVulkanUtils::TimelineSubmitInfo submitInfo;
+
+				timer.timed([&] {
+					CustomVulkanUtils::TimelinePoint point = timelineSync.submit(graphicsTimeline, submitInfo);
+					timelineSync.wait(point);
+				});
+			}));
+
+			timelineSync.cleanup();
+		}
+
+		runFrameLoopBenchmark(out, physicalDevice, surface, device, graphicsQueue, presentQueue, swapChain, swapChainImages, swapChainImageFormat, swapChainExtent, options.iterations);
+
+		// 1000 scopes per sample, so mean_us is the cost of one scope in ns. endFrame drains the buffer outside the timing
+		{
+			CustomVulkanUtils::FrameProfiler frameProfiler;
+			frameProfiler.init(CustomVulkanUtils::FrameProfilerConfig());
+
+			writeResult(out, runBenchmark("scopedFrameTimerX1000", options.iterations, [&](Timer& timer) {
+				timer.timed([&]() {
+					for (uint32_t i = 0; i < 1000; i++) {
+						CustomVulkanUtils::ScopedFrameTimer scopedTimer(frameProfiler, CustomVulkanUtils::FrameStage::Record);
+					}
+				});
+				frameProfiler.endFrame();
+			}));
+		}
+
+		runParallelForBenchmark(out, options.iterations);
+
+		runFrameAllocationBenchmark(out, physicalDevice, surface, options.iterations * 10);
+
+		runMultiDeviceBenchmark(out, instance, options.iterations * 10);
+
+		runResidencyBenchmark(out, physicalDevice);
+
+		runLodBenchmark(out, options.iterations);
+
+		vkDestroySwapchainKHR(device, swapChain, nullptr);
+		vkDestroyDevice(device, nullptr);
+		vkDestroySurfaceKHR(instance, surface, nullptr);
+		vkDestroyInstance(instance, nullptr);
+	}
+	catch (const std::exception& e) {
+		std::cerr << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -6,10 +6,27 @@
 #include <cstdlib>
 #include <vector>
 #include <cstring>
+#include <memory>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <algorithm>
+#include <filesystem>
+#include <cmath>
+#include <utility>
 
 #include "CustomValidationLayer.h"
 #include "PhysicalDeviceUtils.h"
 #include "GraphicsPipelineUtils.h"
+#include "MemoryResidencyManager.h"
+#include "FrameProfiler.h"
+#include "JobSystem.h"
+#include "DeviceGroup.h"
+#include "TimelineSync.h"
+#include "HostAllocationTracker.h"
+#include "FrameArena.h"
+#include "DynamicResolution.h"
+#include "MeshLod.h"
 
 class HelloTriangleApplication {
 public:
@@ -49,6 +66,60 @@ private:
 
 	std::vector<VkImageView> swapChainImageViews; // imageViews that describe how to access the image (2D with Depth or 3D...)
 
+    CustomVulkanUtils::MemoryResidencyManager residencyManager; // tracks device memory per heap and evicts streamable resources near the budget
+    const float memoryBudgetFraction = 0.9f; // start evicting at 90% of the heap budget
+
+    CustomVulkanUtils::FrameProfiler frameProfiler; // per stage CPU timings of the frame loop, also active in release builds
+
+    CustomVulkanUtils::JobSystem jobSystem; // work stealing scheduler for init, later asset loading and command recording
+    std::atomic<int64_t> initWorkNs{ 0 }; // summed duration of all init steps = wall clock time of a sequential init
+
+    // one extra logical device per other suitable graphics card, the window is still presented by device. Every frame
+    // also renders an independent offscreen frame, these are spread round robin over the group
+    const bool enableMultiDevice = false;
+    CustomVulkanUtils::DeviceGroup deviceGroup;
+    std::vector<CustomVulkanUtils::OffscreenTarget> offscreenTargets; // one per group device
+    std::vector<CustomVulkanUtils::JobHandle> offscreenJobs; // last offscreen frame per group device
+    uint64_t droppedOffscreenFrames = 0; // skipped because the device was still busy with its previous frame
+
+    // one timeline semaphore per queue instead of fences, if VK_KHR_timeline_semaphore is supported
+    bool timelineSyncEnabled = false;
+    CustomVulkanUtils::TimelineSync timelineSync;
+    uint32_t graphicsTimeline = 0;
+    uint32_t presentTimeline = 0;
+
+    CustomVulkanUtils::HostAllocationTracker hostAllocator; // counts driver host allocations, passed to every create/destroy call
+    CustomVulkanUtils::FrameArena frameArena{ 256 * 1024 }; // transient CPU data of one frame, reset at the end of each frame
+
+    // every frame renders into a sub-rectangle of an offscreen target and blits it into the swap chain.
+    // With dynamic resolution the sub-rectangle follows the GPU frame time, without it the scale stays at 1
+    const bool enableDynamicResolution = true;
+    const double gpuFrameBudgetMs = 16.6;
+    CustomVulkanUtils::DynamicResolutionController resolutionController;
+    CustomVulkanUtils::GpuFrameTimer gpuFrameTimer;
+    bool gpuTimingEnabled = false;
+    CustomVulkanUtils::ScaledRenderTarget scaledRenderTarget;
+
+    // one frame in flight: waited on with the graphics timeline if available, otherwise with inFlightFence
+    VkCommandPool commandPool = VK_NULL_HANDLE;
+    VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+    VkSemaphore imageAvailableSemaphore = VK_NULL_HANDLE;
+    VkSemaphore renderFinishedSemaphore = VK_NULL_HANDLE;
+    VkFence inFlightFence = VK_NULL_HANDLE;
+    CustomVulkanUtils::TimelineSubmitInfo frameSubmitInfo; // filled once in createFrameResources, its vectors would allocate every frame
+    CustomVulkanUtils::TimelinePoint lastFrame{};
+    bool framePending = false;
+    std::vector<std::function<void()>> pendingReleases; // without timeline sync: run after the next wait on inFlightFence
+    uint64_t fenceSyncNs = 0; // CPU time in fence waits and submits since the last frame, baseline for the timeline path
+
+    // test scene of many objects, each picks a LOD from its screen space error. Selection only, nothing is drawn yet. Without LODs everything is full detail
+    const bool enableLod = true;
+    const std::string sceneMeshPath = "meshes/sphere.mlod"; // LOD chain is generated once and then loaded
+    const CustomVulkanUtils::LodChainSettings sceneLodSettings; // the cached file is regenerated when these change
+    std::vector<CustomVulkanUtils::Mesh> sceneMeshes;
+    std::vector<CustomVulkanUtils::LodInstance> sceneInstances;
+    CustomVulkanUtils::LodSelector lodSelector;
+
     // validation layers for debugging
     const std::vector<const char*> validationLayers = {
     "VK_LAYER_KHRONOS_validation"
@@ -59,6 +130,12 @@ private:
     VK_KHR_SWAPCHAIN_EXTENSION_NAME
     };
 
+    // extensions that are enabled only if the graphics card supports them
+    const std::vector<const char*> optionalDeviceExtensions = {
+    VK_EXT_MEMORY_BUDGET_EXTENSION_NAME,
+    VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME
+    };
+
 #ifdef NDEBUG
     const bool enableValidationLayers = false;
 #else
@@ -77,48 +154,239 @@ private:
     }
 
     void initVulkan() {
-        createInstance();
+        auto initStart = std::chrono::steady_clock::now();
+        jobSystem.init();
 
-        if (enableValidationLayers) {
-            validationLayerManager = CustomVulkanUtils::CustomValidationLayer(instance);
-            validationLayerManager.setupDebugMessenger();
+        auto vertShaderCode = std::make_shared<std::vector<char>>();
+        auto fragShaderCode = std::make_shared<std::vector<char>>();
+
+        // init as dependency graph: instance -> surface -> device -> pipeline, the shader files are loaded in parallel
+        auto instanceJob = jobSystem.schedule(timedInitStep([this]() {
+            createInstance();
+
+            if (enableValidationLayers) {
+                validationLayerManager = CustomVulkanUtils::CustomValidationLayer(instance, hostAllocator.get());
+                validationLayerManager.setupDebugMessenger();
+            }
+        }));
+
+        auto surfaceJob = jobSystem.schedule(timedInitStep([this]() {
+            createSurface();
+        }), { instanceJob });
+
+        auto deviceJob = jobSystem.schedule(timedInitStep([this]() {
+            physicalDevice = CustomVulkanUtils::pickPhysicalDevice(instance, surface, deviceExtensions);
+            device = CustomVulkanUtils::createLogicalDevice(physicalDevice, surface, enableValidationLayers, validationLayers, graphicsQueue, presentQueue, deviceExtensions, optionalDeviceExtensions, hostAllocator.get());
+
+            bool memoryBudgetEnabled = CustomVulkanUtils::isDeviceExtensionSupported(physicalDevice, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+            residencyManager.init(physicalDevice, memoryBudgetEnabled, memoryBudgetFraction, hostAllocator.get());
+            residencyManager.printHeapUsage();
+
+            timelineSyncEnabled = CustomVulkanUtils::isDeviceExtensionSupported(physicalDevice, VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME);
+            if (timelineSyncEnabled) {
+                timelineSync.init(device, hostAllocator.get());
+                timelineSync.setFrameArena(&frameArena); // only used from the main thread
+                graphicsTimeline = timelineSync.registerQueue(graphicsQueue);
+                presentTimeline = timelineSync.registerQueue(presentQueue); // same timeline if both queues are the same
+
+                // evicted resources may be used by the frame in flight, free them once the last submitted frame is done
+                residencyManager.setReleaseDeferrer([this](std::function<void()> release) {
+                    timelineSync.deferRelease(timelineSync.lastSubmitted(graphicsTimeline), release);
+                });
+            }
+            else {
+                residencyManager.setReleaseDeferrer([this](std::function<void()> release) {
+                    pendingReleases.push_back(release);
+                });
+            }
+        }), { surfaceJob });
+
+        auto vertShaderJob = jobSystem.schedule(timedInitStep([vertShaderCode]() {
+            *vertShaderCode = CustomVulkanUtils::readFile("shaders/vert.spv");
+        }));
+
+        auto fragShaderJob = jobSystem.schedule(timedInitStep([fragShaderCode]() {
+            *fragShaderCode = CustomVulkanUtils::readFile("shaders/frag.spv");
+        }));
+
+        auto pipelineJob = jobSystem.schedule(timedInitStep([this, vertShaderCode, fragShaderCode]() {
+            CustomVulkanUtils::createGraphicsPipeline(device, *vertShaderCode, *fragShaderCode, hostAllocator.get());
+        }), { deviceJob, vertShaderJob, fragShaderJob });
+
+        auto sceneJob = jobSystem.schedule(timedInitStep([this]() {
+            loadScene();
+        }));
+
+        CustomVulkanUtils::JobHandle deviceGroupJob;
+        if (enableMultiDevice) {
+            deviceGroupJob = jobSystem.schedule(timedInitStep([this]() {
+                deviceGroup.init(instance, enableValidationLayers, validationLayers, 0, physicalDevice, hostAllocator.get()); // physicalDevice already has device
+                deviceGroup.printDevices();
+
+                for (uint32_t i = 0; i < deviceGroup.getDeviceCount(); i++) {
+                    offscreenTargets.push_back(CustomVulkanUtils::createOffscreenTarget(deviceGroup.getDevice(i), { WIDTH, HEIGHT }));
+                }
+                offscreenJobs.resize(deviceGroup.getDeviceCount());
+            }), { deviceJob });
         }
 
-        createSurface();
-        
-        physicalDevice = CustomVulkanUtils::pickPhysicalDevice(instance, surface, deviceExtensions);
-        device = CustomVulkanUtils::createLogicalDevice(physicalDevice, surface, enableValidationLayers, validationLayers, graphicsQueue, presentQueue, deviceExtensions);
-        swapChain = CustomVulkanUtils::createSwapChain(swapChainImages, swapChainImageFormat, swapChainExtent, window, physicalDevice, device, surface);
-		CustomVulkanUtils::createImageViews(swapChainImageViews, swapChainImages, swapChainImageFormat, device);
+        std::vector<CustomVulkanUtils::JobHandle> initJobs = { instanceJob, surfaceJob, deviceJob, vertShaderJob, fragShaderJob, pipelineJob, sceneJob };
+        if (deviceGroupJob) {
+            initJobs.push_back(deviceGroupJob);
+        }
 
-		CustomVulkanUtils::createGraphicsPipeline(device);
+        // the swap chain stays on the main thread: chooseSwapExtent may call glfwGetFramebufferSize. Runs in parallel to the pipeline
+        try {
+            jobSystem.wait(deviceJob);
+            timedInitStep([this]() {
+                swapChain = CustomVulkanUtils::createSwapChain(swapChainImages, swapChainImageFormat, swapChainExtent, window, physicalDevice, device, surface, hostAllocator.get());
+                CustomVulkanUtils::createImageViews(swapChainImageViews, swapChainImages, swapChainImageFormat, device, hostAllocator.get());
+                createFrameResources();
+
+                lodSelector.setProjection(static_cast<float>(swapChainExtent.height), 0.785f); // 45 degree vertical field of view
+            })();
+        }
+        catch (...) {
+            // the other init jobs still use members, they have to be finished before the exception leaves initVulkan
+            try {
+                jobSystem.waitAll(initJobs);
+            }
+            catch (...) {
+            }
+            throw;
+        }
+
+        jobSystem.waitAll(initJobs); // rethrows the first failed step once all of them are done
+
+        double wallClockMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - initStart).count();
+        double sequentialMs = initWorkNs / 1.0e6;
+        std::cout << "initVulkan: " << wallClockMs << " ms wall clock, " << sequentialMs << " ms of init work, saved "
+            << (sequentialMs - wallClockMs) << " ms with " << jobSystem.getWorkerCount() << " workers\n";
+    }
+
+    // wrap an init step, so its duration is added to initWorkNs
+    std::function<void()> timedInitStep(std::function<void()> step) {
+        return [this, step]() {
+            auto start = std::chrono::steady_clock::now();
+            step();
+            initWorkNs += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+        };
     }
 
     void mainLoop() {
+
+        CustomVulkanUtils::FrameProfilerConfig profilerConfig;
+        profilerConfig.windowFrames = 300;
+        profilerConfig.exportIntervalSeconds = 5.0;
+        profilerConfig.exportFormat = CustomVulkanUtils::ProfilerExportFormat::CSV;
+        profilerConfig.exportPath = "frame_timings.csv";
+        frameProfiler.init(profilerConfig);
+
+        uint64_t frameCount = 0;
+        uint64_t frameHostAllocations = 0;
+        uint64_t maxFrameHostAllocations = 0;
+        uint64_t totalSyncNs = 0;
+        uint64_t maxFrameSyncNs = 0;
+        uint64_t sceneTriangles = 0;
+        uint64_t sceneFullDetailTriangles = 0;
         
         while (!glfwWindowShouldClose(window)) { // endless loop till window closes
-            glfwPollEvents(); //check for key events
+            uint64_t allocationsBefore = hostAllocator.getTotalAllocations();
+
+            {
+                CustomVulkanUtils::ScopedFrameTimer frameTimer(frameProfiler, CustomVulkanUtils::FrameStage::Frame);
+
+                glfwPollEvents(); //check for key events
+                residencyManager.update(); // refresh heap budgets, evict least recently used streamable resources
+
+                CustomVulkanUtils::LodStats lodStats = updateScene(frameCount);
+                sceneTriangles += lodStats.triangles;
+                sceneFullDetailTriangles += lodStats.fullDetailTriangles;
+
+                drawFrame();
+                submitOffscreenFrame(frameCount);
+            }
+
+            // CPU time of this frame in synchronisation calls, fences or timeline semaphores
+            uint64_t syncNs = timelineSyncEnabled ? timelineSync.consumeSyncTimeNs() : std::exchange(fenceSyncNs, 0);
+            totalSyncNs += syncNs;
+            maxFrameSyncNs = std::max(maxFrameSyncNs, syncNs);
+
+            frameProfiler.endFrame();
+            frameArena.reset();
+
+            // driver allocations inside the frame loop are heap traffic we want to get rid of
+            uint64_t allocations = hostAllocator.getTotalAllocations() - allocationsBefore;
+            frameHostAllocations += allocations;
+            maxFrameHostAllocations = std::max(maxFrameHostAllocations, allocations);
+            frameCount++;
+        }
+
+        vkDeviceWaitIdle(device); // the last frame may still be in flight
+        runPendingReleases();
+
+        for (uint32_t i = 0; i < offscreenJobs.size(); i++) {
+            if (offscreenJobs[i]) {
+                jobSystem.wait(offscreenJobs[i]);
+            }
+            CustomVulkanUtils::waitOffscreenTarget(deviceGroup.getDevice(i), offscreenTargets[i]); // jobs only submit
+        }
+
+        frameProfiler.printStats();
+
+        if (enableDynamicResolution) {
+            std::cout << "dynamic resolution: " << resolutionController.getChanges().size() << " scale changes, final scale " << resolutionController.getScale() << '\n';
+            resolutionController.writeLog("resolution_scale_log.csv");
+        }
+
+        if (frameCount > 0) {
+            std::cout << "driver host allocations per frame: " << static_cast<double>(frameHostAllocations) / frameCount << " avg, " << maxFrameHostAllocations << " max\n";
+            std::cout << "CPU sync time per frame (" << (timelineSyncEnabled ? "timeline semaphores" : "fences") << "): "
+                << totalSyncNs / 1000.0 / frameCount << " us avg, " << maxFrameSyncNs / 1000.0 << " us max\n";
+            std::cout << "frame arena: " << frameArena.getPeakBytes() << " of " << frameArena.getCapacity() << " bytes peak, "
+                << frameArena.getLastFrameOverflowBytes() << " bytes overflow in the last frame\n";
+            if (deviceGroup.getDeviceCount() > 0) {
+                std::cout << "offscreen frames dropped because the group device was busy: " << droppedOffscreenFrames << " of " << frameCount << '\n';
+            }
+            std::cout << "LOD selection only, nothing is drawn yet: " << sceneTriangles / frameCount << " triangles per frame selected"
+                << (enableLod ? " with LOD, " : " without LOD, ")
+                << sceneFullDetailTriangles / frameCount << " at full detail\n";
         }
 
     }
 
     void cleanup() {
 
+        jobSystem.shutdown();
+
         if (enableValidationLayers) {
             validationLayerManager.cleanup();
         }
 
 		for (auto imageView : swapChainImageViews) {
-			vkDestroyImageView(device, imageView, nullptr);
+			vkDestroyImageView(device, imageView, hostAllocator.get());
 		}
 
-        vkDestroySwapchainKHR(device, swapChain, nullptr);
+        vkDestroySwapchainKHR(device, swapChain, hostAllocator.get());
+        destroyFrameResources();
+
+        if (timelineSyncEnabled) {
+            timelineSync.cleanup();
+        }
+
+        vkDestroyDevice(device, hostAllocator.get());
+
+        for (uint32_t i = 0; i < offscreenTargets.size(); i++) {
+            CustomVulkanUtils::destroyOffscreenTarget(deviceGroup.getDevice(i), offscreenTargets[i]);
+        }
+
+        deviceGroup.cleanup();
 
-        vkDestroyDevice(device, nullptr);
+        vkDestroySurfaceKHR(instance, surface, hostAllocator.get());
 
-        vkDestroySurfaceKHR(instance, surface, nullptr);
+        vkDestroyInstance(instance, hostAllocator.get());
 
-        vkDestroyInstance(instance, nullptr);
+        hostAllocator.printStats();
 
         glfwDestroyWindow(window);
 
@@ -156,7 +424,7 @@ private:
         appInfo.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
         appInfo.pEngineName = "No Engine";
         appInfo.engineVersion = VK_MAKE_VERSION(1, 0, 0);
-        appInfo.apiVersion = VK_API_VERSION_1_0;
+        appInfo.apiVersion = VK_API_VERSION_1_1; // 1.1 for vkGetPhysicalDeviceMemoryProperties2 (VK_EXT_memory_budget)
 
         // store information about global extensions and validation layers
         VkInstanceCreateInfo createInfo{};
@@ -180,17 +448,281 @@ private:
         }
 
         // create vulkan instance with specified information and store in private variable
-        if (vkCreateInstance(&createInfo, nullptr, &instance) != VK_SUCCESS) {
+        if (vkCreateInstance(&createInfo, hostAllocator.get(), &instance) != VK_SUCCESS) {
             throw std::runtime_error("Failed to create instance!");
         }
     }
 
     void createSurface() {
-        if (glfwCreateWindowSurface(instance, window, nullptr, &surface) != VK_SUCCESS) {
+        if (glfwCreateWindowSurface(instance, window, hostAllocator.get(), &surface) != VK_SUCCESS) {
             throw std::runtime_error("failed to create window surface!");
         }
     }
 
+    void loadScene() {
+        CustomVulkanUtils::Mesh mesh;
+
+        if (std::filesystem::exists(sceneMeshPath)) {
+            try {
+                mesh = CustomVulkanUtils::readMesh(sceneMeshPath);
+            }
+            catch (const std::runtime_error& e) {
+                std::cout << "regenerating " << sceneMeshPath << ": " << e.what() << '\n';
+                mesh = CustomVulkanUtils::Mesh();
+            }
+        }
+
+        if (mesh.lods.empty() || mesh.lodSettings != sceneLodSettings) {
+            // offline step, only runs if there is no valid mesh file for the current LOD settings yet
+            mesh = CustomVulkanUtils::createSphereMesh(64, 128, 1.0f);
+            CustomVulkanUtils::generateLodChain(mesh, sceneLodSettings);
+
+            std::filesystem::create_directories(std::filesystem::path(sceneMeshPath).parent_path());
+            CustomVulkanUtils::writeMesh(sceneMeshPath, mesh);
+        }
+
+        sceneMeshes.push_back(std::move(mesh));
+
+        // 32 x 32 grid, so near and far objects are visible at the same time
+        for (uint32_t x = 0; x < 32; x++) {
+            for (uint32_t z = 0; z < 32; z++) {
+                CustomVulkanUtils::LodInstance gridInstance;
+                gridInstance.mesh = 0;
+                gridInstance.position[0] = x * 4.0f;
+                gridInstance.position[1] = 0.0f;
+                gridInstance.position[2] = z * 4.0f;
+                sceneInstances.push_back(gridInstance);
+            }
+        }
+    }
+
+    // camera circles over the grid, returns the triangles the LOD selection picked this frame
+    CustomVulkanUtils::LodStats updateScene(uint64_t frame) {
+        float angle = frame * 0.002f;
+        float cameraPosition[3] = { 62.0f + 70.0f * std::cos(angle), 10.0f, 62.0f + 70.0f * std::sin(angle) };
+
+        return lodSelector.update(sceneMeshes, sceneInstances, cameraPosition, enableLod);
+    }
+
+    void createFrameResources() {
+        // every frame ends with a blit into the swap chain image, refuse devices that cannot do that
+        VkImageUsageFlags swapChainUsage = CustomVulkanUtils::querySwapChainSupport(physicalDevice, surface).capabilities.supportedUsageFlags;
+        if (!CustomVulkanUtils::ScaledRenderTarget::isSupported(physicalDevice, swapChainImageFormat, swapChainUsage)) {
+            throw std::runtime_error("swap chain does not support blitting into its images!");
+        }
+
+        uint32_t graphicsFamily = CustomVulkanUtils::findQueueFamilies(physicalDevice, surface).graphicsFamily.value();
+
+        VkCommandPoolCreateInfo poolInfo{};
+        poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+        poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT; // the command buffer is re-recorded every frame
+        poolInfo.queueFamilyIndex = graphicsFamily;
+
+        if (vkCreateCommandPool(device, &poolInfo, hostAllocator.get(), &commandPool) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create command pool!");
+        }
+
+        VkCommandBufferAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocInfo.commandPool = commandPool;
+        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        allocInfo.commandBufferCount = 1;
+
+        if (vkAllocateCommandBuffers(device, &allocInfo, &commandBuffer) != VK_SUCCESS) {
+            throw std::runtime_error("failed to allocate command buffer!");
+        }
+
+        VkSemaphoreCreateInfo semaphoreInfo{};
+        semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+        VkFenceCreateInfo fenceInfo{};
+        fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+        fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT; // the first frame must not wait
+
+        if (vkCreateSemaphore(device, &semaphoreInfo, hostAllocator.get(), &imageAvailableSemaphore) != VK_SUCCESS ||
+            vkCreateSemaphore(device, &semaphoreInfo, hostAllocator.get(), &renderFinishedSemaphore) != VK_SUCCESS ||
+            vkCreateFence(device, &fenceInfo, hostAllocator.get(), &inFlightFence) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create frame synchronization objects!");
+        }
+
+        frameSubmitInfo.commandBuffers = { commandBuffer };
+        frameSubmitInfo.binaryWaits = { imageAvailableSemaphore };
+        frameSubmitInfo.binaryWaitStages = { VK_PIPELINE_STAGE_TRANSFER_BIT };
+        frameSubmitInfo.binarySignals = { renderFinishedSemaphore };
+
+        // max scale 1: the offscreen target has the size of the swap chain and is never reallocated
+        resolutionController.init(gpuFrameBudgetMs, 0.5f, 1.0f);
+        scaledRenderTarget.init(physicalDevice, device, residencyManager, swapChainExtent, swapChainImageFormat, hostAllocator.get());
+
+        gpuTimingEnabled = gpuFrameTimer.init(physicalDevice, device, graphicsFamily, 1, hostAllocator.get());
+        if (!gpuTimingEnabled) {
+            std::cout << "no timestamp support on the graphics queue, dynamic resolution keeps the full resolution\n";
+        }
+    }
+
+    void destroyFrameResources() {
+        gpuFrameTimer.cleanup();
+        scaledRenderTarget.cleanup();
+
+        vkDestroyFence(device, inFlightFence, hostAllocator.get());
+        vkDestroySemaphore(device, renderFinishedSemaphore, hostAllocator.get());
+        vkDestroySemaphore(device, imageAvailableSemaphore, hostAllocator.get());
+        vkDestroyCommandPool(device, commandPool, hostAllocator.get());
+    }
+
+    // frame i goes to group device i % deviceCount. Never blocks the presenting frame loop: if the job of frame i - deviceCount
+    // is still running, frame i is dropped for that device. The job itself waits for the GPU, see renderOffscreenFrame
+    void submitOffscreenFrame(uint64_t frame) {
+        uint32_t deviceCount = deviceGroup.getDeviceCount();
+        if (deviceCount == 0) {
+            return;
+        }
+
+        uint32_t slot = static_cast<uint32_t>(frame % deviceCount);
+        if (offscreenJobs[slot]) {
+            if (!jobSystem.isFinished(offscreenJobs[slot])) {
+                droppedOffscreenFrames++;
+                return;
+            }
+            jobSystem.wait(offscreenJobs[slot]); // finished, only rethrows a failure
+        }
+
+        CustomVulkanUtils::OffscreenTarget* target = &offscreenTargets[slot];
+        float shade = static_cast<float>(frame % 256) / 255.0f;
+
+        offscreenJobs[slot] = deviceGroup.submitFrame(jobSystem, frame, [target, shade](CustomVulkanUtils::DeviceContext& context) {
+            CustomVulkanUtils::renderOffscreenFrame(context, *target, { { shade, shade, shade, 1.0f } });
+        });
+    }
+
+    // same calls the timeline path counts in TimelineSync::consumeSyncTimeNs: submit and CPU waits
+    void addFenceSyncTime(std::chrono::steady_clock::time_point start) {
+        fenceSyncNs += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    void runPendingReleases() {
+        for (auto& release : pendingReleases) {
+            release();
+        }
+        pendingReleases.clear();
+    }
+
+    void drawFrame() {
+        {
+            CustomVulkanUtils::ScopedFrameTimer waitTimer(frameProfiler, CustomVulkanUtils::FrameStage::FenceWait);
+
+            if (timelineSyncEnabled) {
+                if (framePending) {
+                    timelineSync.wait(lastFrame);
+                }
+                timelineSync.collect(); // release resources whose last use is done on the GPU, counterpart of runPendingReleases
+            }
+            else {
+                auto syncStart = std::chrono::steady_clock::now();
+                vkWaitForFences(device, 1, &inFlightFence, VK_TRUE, UINT64_MAX);
+                vkResetFences(device, 1, &inFlightFence);
+                addFenceSyncTime(syncStart);
+
+                runPendingReleases();
+            }
+        }
+
+        // the previous frame is done, so its timestamps are available
+        double gpuFrameMs = 0.0;
+        if (enableDynamicResolution && gpuTimingEnabled && gpuFrameTimer.read(0, gpuFrameMs)) {
+            resolutionController.update(gpuFrameMs);
+        }
+        VkExtent2D renderExtent = resolutionController.scaledExtent(swapChainExtent);
+
+        uint32_t imageIndex;
+        {
+            CustomVulkanUtils::ScopedFrameTimer acquireTimer(frameProfiler, CustomVulkanUtils::FrameStage::Acquire);
+
+            VkResult result = vkAcquireNextImageKHR(device, swapChain, UINT64_MAX, imageAvailableSemaphore, VK_NULL_HANDLE, &imageIndex);
+            if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR) {
+                throw std::runtime_error("failed to acquire swap chain image!");
+            }
+        }
+
+        {
+            CustomVulkanUtils::ScopedFrameTimer recordTimer(frameProfiler, CustomVulkanUtils::FrameStage::Record);
+
+            vkResetCommandBuffer(commandBuffer, 0);
+
+            VkCommandBufferBeginInfo beginInfo{};
+            beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+            beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+            if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
+                throw std::runtime_error("failed to begin recording command buffer!");
+            }
+
+            // only the scaled scene pass is timed: the upscale waits for imageAvailableSemaphore, so timing it would
+            // count acquire/vsync stalls as GPU load and lower the scale although the GPU is not the bottleneck
+            if (gpuTimingEnabled) {
+                gpuFrameTimer.begin(commandBuffer, 0);
+            }
+
+            // the scene pass covers scaledRenderTarget.renderArea(renderExtent) only, for now it is only cleared
+            scaledRenderTarget.beginScenePass(commandBuffer, renderExtent, { { 0.1f, 0.2f, 0.4f, 1.0f } });
+            scaledRenderTarget.endScenePass(commandBuffer);
+
+            if (gpuTimingEnabled) {
+                gpuFrameTimer.end(commandBuffer, 0);
+            }
+
+            scaledRenderTarget.recordUpscale(commandBuffer, renderExtent, swapChainImages[imageIndex], swapChainExtent);
+
+            if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+                throw std::runtime_error("failed to record command buffer!");
+            }
+        }
+
+        {
+            CustomVulkanUtils::ScopedFrameTimer submitTimer(frameProfiler, CustomVulkanUtils::FrameStage::Submit);
+
+            if (timelineSyncEnabled) {
+                lastFrame = timelineSync.submit(graphicsTimeline, frameSubmitInfo);
+                framePending = true;
+            }
+            else {
+                VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+
+                VkSubmitInfo submitInfo{};
+                submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+                submitInfo.waitSemaphoreCount = 1;
+                submitInfo.pWaitSemaphores = &imageAvailableSemaphore;
+                submitInfo.pWaitDstStageMask = &waitStage;
+                submitInfo.commandBufferCount = 1;
+                submitInfo.pCommandBuffers = &commandBuffer;
+                submitInfo.signalSemaphoreCount = 1;
+                submitInfo.pSignalSemaphores = &renderFinishedSemaphore;
+
+                auto syncStart = std::chrono::steady_clock::now();
+                VkResult result = vkQueueSubmit(graphicsQueue, 1, &submitInfo, inFlightFence);
+                addFenceSyncTime(syncStart);
+
+                if (result != VK_SUCCESS) {
+                    throw std::runtime_error("failed to submit draw command buffer!");
+                }
+            }
+        }
+
+        {
+            CustomVulkanUtils::ScopedFrameTimer presentTimer(frameProfiler, CustomVulkanUtils::FrameStage::Present);
+
+            VkPresentInfoKHR presentInfo{};
+            presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
+            presentInfo.waitSemaphoreCount = 1;
+            presentInfo.pWaitSemaphores = &renderFinishedSemaphore;
+            presentInfo.swapchainCount = 1;
+            presentInfo.pSwapchains = &swapChain;
+            presentInfo.pImageIndices = &imageIndex;
+
+            vkQueuePresentKHR(presentQueue, &presentInfo);
+        }
+    }
+
     std::vector<const char*> getRequiredExtensions() {
         uint32_t glfwExtensionCount = 0;
         const char** glfwExtensions;